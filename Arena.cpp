@@ -0,0 +1,30 @@
+#include "Arena.h"
+
+thread_local constinit Arena* Arena::current = nullptr;
+
+Arena::~Arena()
+{
+  for (char* block : blocks)
+    delete[] block;
+}
+
+/* what's left of the current block is wasted, nodes are small compared to a block */
+void Arena::grow(size_t size)
+{
+  size_t blockSize = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+  char* block = new char[blockSize];
+  blocks.push_back(block);
+  next = block;
+  end = block + blockSize;
+}
+
+/* this arena keeps allocating in its own block, what's left of other's is wasted */
+void Arena::adopt(Arena& other)
+{
+  blocks.insert(blocks.end(), other.blocks.begin(), other.blocks.end());
+  allocations += other.allocations;
+  used += other.used;
+  other.blocks.clear();
+  other.next = other.end = nullptr;
+  other.allocations = other.used = 0;
+}
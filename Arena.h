@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Bump allocator the AST of one program lives in. Expr and Stmt take
+ * their memory from the current arena (operator new) and never give it
+ * back (operator delete does nothing), the whole program goes at once
+ * when its Arena does. Nodes still get destructed, for what they own
+ * outside the arena: vectors of children and string literals.
+ */
+class Arena
+{
+public:
+  Arena() = default;
+  ~Arena();
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t size)
+  {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (size > size_t(end - next))
+      grow(size);
+    void* ptr = next;
+    next += size;
+    allocations++;
+    used += size;
+    return ptr;
+  }
+
+  /*
+   * Expr and Stmt's operator new. a node made outside a Scope would have
+   * nowhere to go, and operator delete couldn't tell it apart to free it
+   */
+  static void* allocateNode(size_t size)
+  {
+    assert(current != nullptr && "AST nodes are only made inside an Arena::Scope");
+    return current->allocate(size);
+  }
+
+  /* how many nodes and bytes were handed out */
+  size_t getAllocations() const { return allocations; }
+  size_t getUsed() const { return used; }
+
+  /* takes over other's blocks, what's been allocated in it now lives as long as this */
+  void adopt(Arena& other);
+
+  /*
+   * where nodes go, only set while the Parser and Optimizer run, see
+   * Scope. per thread, the front end parses on several (FrontEnd.h)
+   */
+  static thread_local constinit Arena* current;
+
+  /* makes an arena current for as long as it lives */
+  class Scope
+  {
+  public:
+    Scope(Arena& arena) : previous(current) { current = &arena; }
+    ~Scope() { current = previous; }
+  private:
+    Arena* previous;
+  };
+
+  static constexpr size_t BLOCK_SIZE = 64 * 1024;
+  static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+private:
+  void grow(size_t size);
+
+  std::vector<char*> blocks;
+  char* next = nullptr;
+  char* end = nullptr;
+  size_t allocations = 0;
+  size_t used = 0;
+};
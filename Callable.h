@@ -1,59 +1,111 @@
+#pragma once
+
 #include <vector>
-#include <any>
 #include <iostream>
-#include "Environment.h"
+#include "Value.h"
 #include "Interpreter.h"
 
-class Callable
+class Callable : public Object
 {
 public:
-  Callable(Lambda* laDeclaration, Environment* closure)
-    : laDeclaration(laDeclaration), closure(closure)
+  /* name is null for lambdas */
+  Callable(FunctionInfo* info, const Token* name)
+    : Object(VAL_CALLABLE), info(info), name(name)
   {
-    params = laDeclaration->getParams();
+    memory.charge(getSize());
+    upvalues.reserve(info->captures.size());
+    trackObject(this);
   }
 
-  Callable(Function* declaration, Environment *closure)
-    : declaration(declaration), closure(closure)
+  ~Callable()
   {
-    params = declaration->getParams();
+    memory.release(getSize());
   }
 
-  std::any call(Interpreter& interpreter, const std::vector<std::any>& args)
+  /*
+   * a new closure over info, running in frame of the enclosing function.
+   * captured locals get boxed in a Cell the first time a closure takes them
+   */
+  static Value closure(FunctionInfo& info, const Token* name, Value* frame, Callable* enclosing)
   {
-    std::any returnValue;
-    Environment closureClone = *closure;
-    Environment funcEnvironment = Environment(&closureClone);
-
-    for (int i = 0; i < params.size(); i++)
-      funcEnvironment.define(params.at(i).lexeme,
-                         args.at(i));
- 
-    try
-    {
-      interpreter.executeBlock((laDeclaration != nullptr) ? laDeclaration->getBody()
-                                                          :   declaration->getBody(),
-                                                          funcEnvironment);
-    }
-    catch (std::any ret)
+    Callable* closure = new Callable(&info, name);
+    Value value = Value(closure);
+    for (const Capture& capture : info.captures)
     {
-      /*
-       * took me just a couple fucking hours to realize i had
-       * to set the environment back to normal after returning
-       */
-      returnValue = ret;
+      if (!capture.isLocal)
+      {
+        closure->addUpvalue(Value(enclosing->getUpvalue(capture.index)));
+        continue;
+      }
+      Value& slot = frame[capture.index];
+      if (!slot.isCell())
+        slot = Value(new Cell(slot));
+      closure->addUpvalue(slot);
     }
-    interpreter.setEnv(closureClone);
-    return returnValue;
+    return value;
+  }
+
+  /* frame already holds the args, see Interpreter::visitCallExpr */
+  Value call(Interpreter& interpreter, Value* frame)
+  {
+    Completion completion = interpreter.executeFunction(this, frame);
+    if (completion.type == COMPLETION_RETURN)
+      return std::move(completion.value);
+    return Value();
   }
 
   int getArity()
   {
-    return params.size();
+    return info->getArity();
+  }
+
+  FunctionInfo& getInfo()
+  {
+    return *info;
+  }
+
+  /* the Cell captured for upvalue i */
+  Cell* getUpvalue(int i)
+  {
+    return upvalues[i].asCell();
+  }
+
+  void addUpvalue(Value cell)
+  {
+    upvalues.push_back(std::move(cell));
+  }
+
+  /* for the Heap, which has to see them and break cycles through them */
+  std::vector<Value>& getUpvalues()
+  {
+    return upvalues;
+  }
+
+  std::string toString()
+  {
+    if (name != nullptr)
+      return "<function " + std::string(name->lexeme) + ">";
+    return "<lambda>";
   }
 private:
-  Lambda* laDeclaration = nullptr;
-  Function* declaration = nullptr;
-  std::vector<Token> params;
-  Environment *closure = nullptr;
-};
\ No newline at end of file
+  /* what it counts for in Memory, the closure and its upvalues */
+  size_t getSize() const
+  {
+    return sizeof(Callable) + info->captures.size() * sizeof(Value);
+  }
+
+  FunctionInfo* info;
+  const Token* name;
+  std::vector<Value> upvalues;
+};
+
+inline Value::Value(Callable* callable) : type(VAL_CALLABLE)
+{
+  as.object = callable;
+  retain();
+}
+
+inline Callable* Value::asCallable() const
+{
+  return static_cast<Callable*>(as.object);
+}
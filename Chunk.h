@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Value.h"
+#include "Token.h"
+
+class FunctionInfo;
+
+/*
+ * Instructions for the VM. Operands are 24 bit, little endian, right
+ * after the opcode, a generated script has more than 64K globals or
+ * constants. Stack effects are in the comments, locals aren't on the
+ * value stack but in the frame slots the Resolver handed out.
+ */
+enum OpCode : uint8_t
+{
+  OP_CONSTANT,       /* k       -> constants[k] */
+  OP_NIL,            /*         -> nil */
+  OP_TRUE,           /*         -> true */
+  OP_FALSE,          /*         -> false */
+  OP_POP,            /* a       -> */
+
+  OP_GET_LOCAL,      /* s       -> slots[s] */
+  OP_SET_LOCAL,      /* s a     -> a, slots[s] = a */
+  OP_DEFINE_LOCAL,   /* s a     -> , slots[s] = a, also an assignment statement */
+  OP_GET_CELL,       /* s       -> the value in the Cell in slots[s] */
+  OP_SET_CELL,       /* s a     -> a */
+  OP_DEFINE_CELL,    /* s a     -> , slots[s] = new Cell(a) */
+  OP_NEW_CELL,       /* s       -> , slots[s] = new Cell(nil), for local functions that call themselves */
+  OP_GET_UPVALUE,    /* i       -> */
+  OP_SET_UPVALUE,    /* i a     -> a */
+  OP_GET_GLOBAL,     /* g       -> */
+  OP_SET_GLOBAL,     /* g a     -> a */
+  OP_STORE_GLOBAL,   /* g a     -> , an assignment statement */
+  OP_DEFINE_GLOBAL,  /* g a     -> */
+
+  OP_EQUAL,          /* a b     -> a == b */
+  OP_NOT_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_LESS,
+  OP_LESS_EQUAL,
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_NOT,            /* a       -> !a */
+  OP_NEGATE,         /* a       -> -a */
+
+  OP_PRINT,          /* a       -> */
+  OP_JUMP,           /* d       ip += d */
+  OP_JUMP_IF_FALSE,  /* d a     -> , ip += d if a is falsey */
+  OP_AND,            /* d a     -> a and jump if a is falsey, otherwise -> */
+  OP_OR,             /* d a     -> a and jump if a is truthy, otherwise -> */
+  OP_LOOP,           /* d       ip -= d */
+
+  OP_CLOSURE,        /* f       -> closure over functions[f] */
+  OP_CALL,           /* n f args... -> result */
+  OP_TAIL_CALL,      /* n f args... -> , replaces the running call */
+  OP_RETURN,         /* a       -> , a is the call's result */
+  OP_RETURN_NIL      /* end of a function body or of the script */
+};
+
+constexpr int OPERAND_SIZE = 3;
+constexpr int MAX_OPERAND = (1 << 24) - 1;
+
+/* bytecode for one function body or one top-level program */
+struct Chunk
+{
+  std::vector<uint8_t> code;
+  std::vector<Value> constants;
+  /* what OP_CLOSURE makes, the function and its name (null for lambdas) */
+  std::vector<std::pair<FunctionInfo*, const Token*>> functions;
+  /* code offset of every instruction that can fail and the token to blame, sorted */
+  std::vector<std::pair<int, const Token*>> tokens;
+  /* value stack slots needed above the frame's locals */
+  int maxStack = 0;
+
+  /* the token of the failing instruction that offset is in */
+  const Token& tokenAt(int offset) const
+  {
+    auto it = std::upper_bound(tokens.begin(), tokens.end(), offset,
+      [](int offset, const std::pair<int, const Token*>& entry) { return offset < entry.first; });
+    return *std::prev(it)->second;
+  }
+};
@@ -0,0 +1,1017 @@
+#include "ClosureEngine.h"
+#include "Callable.h"
+#include "Stats.h"
+#include <utility>
+
+/* a compiled expression, eval runs it */
+struct CompiledExpr
+{
+  using Eval = Value (*)(const CompiledExpr* self, ClosureEngine& engine);
+  using Test = bool (*)(const CompiledExpr* self, ClosureEngine& engine);
+
+  Eval eval = nullptr;
+  /* the value as a condition, set to something quicker than isTruthy(eval()) where there is one */
+  Test test = nullptr;
+
+  virtual ~CompiledExpr() = default;
+};
+
+/* a compiled statement, exec runs it */
+struct CompiledStmt
+{
+  using Exec = Completion (*)(const CompiledStmt* self, ClosureEngine& engine);
+
+  Exec exec = nullptr;
+
+  virtual ~CompiledStmt() = default;
+};
+
+/* what a binary operator reads its operands from */
+enum OperandKind
+{
+  OPERAND_ANY,    /* call the child's closure */
+  OPERAND_LOCAL,  /* read the frame slot directly */
+  OPERAND_CONST   /* the literal, stored in the node */
+};
+
+struct Operand
+{
+  OperandKind kind = OPERAND_ANY;
+  CompiledExpr* expr = nullptr;
+  int slot = 0;
+  Value value;
+};
+
+struct ConstExpr : CompiledExpr
+{
+  Value value;
+};
+
+/* reads a local, cell, upvalue or global */
+struct VarExpr : CompiledExpr
+{
+  int slot;
+  const Token* name;
+};
+
+struct AssignExpr : CompiledExpr
+{
+  int slot;
+  const Token* name;
+  CompiledExpr* value;
+};
+
+struct UnaryExpr : CompiledExpr
+{
+  const Token* op;
+  CompiledExpr* right;
+};
+
+struct LogicalExpr : CompiledExpr
+{
+  CompiledExpr* left;
+  CompiledExpr* right;
+};
+
+struct BinaryExpr : CompiledExpr
+{
+  const Token* op;
+  Operand left;
+  Operand right;
+};
+
+struct CallExpr : CompiledExpr
+{
+  const Token* paren;
+  CompiledExpr* callee;
+  std::vector<CompiledExpr*> args;
+  /* the one thing running a node changes */
+  mutable CallCache cache;
+};
+
+struct LambdaExpr : CompiledExpr
+{
+  FunctionInfo* info;
+};
+
+struct ExprStmt : CompiledStmt
+{
+  CompiledExpr* expr;
+};
+
+/* var and assignment statements, function declarations */
+struct StoreStmt : CompiledStmt
+{
+  int slot;
+  const Token* name;
+  CompiledExpr* value;
+};
+
+struct FunctionStmt : CompiledStmt
+{
+  int slot;
+  FunctionInfo* info;
+  const Token* name;
+};
+
+struct BlockStmt : CompiledStmt
+{
+  std::vector<CompiledStmt*> statements;
+};
+
+struct IfStmt : CompiledStmt
+{
+  CompiledExpr* condition;
+  CompiledStmt* thenBranch;
+  /* null when there's no else */
+  CompiledStmt* elseBranch;
+};
+
+struct WhileStmt : CompiledStmt
+{
+  CompiledExpr* condition;
+  CompiledStmt* body;
+};
+
+struct ReturnStmt : CompiledStmt
+{
+  /* a CallExpr for a tail call */
+  CompiledExpr* value;
+};
+
+/* captured locals are boxed, but a slot whose declaration never ran isn't */
+static Value& cellValue(Value& slot)
+{
+  return slot.isCell() ? slot.asCell()->value : slot;
+}
+
+[[noreturn]] static void numbersError(const Token* op)
+{
+  throw std::make_pair(*op, std::string("Operands must be numbers."));
+}
+
+/*
+ * The closures themselves. They're static members so they can get at
+ * ClosureEngine's frame, a struct so ClosureEngine can be friends with
+ * all of them at once.
+ */
+struct Closures
+{
+  template <typename T>
+  static const T* as(const CompiledExpr* self)
+  {
+    return static_cast<const T*>(self);
+  }
+
+  template <typename T>
+  static const T* as(const CompiledStmt* self)
+  {
+    return static_cast<const T*>(self);
+  }
+
+  static bool truthy(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    return isTruthy(self->eval(self, engine));
+  }
+
+  static Value constant(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    return as<ConstExpr>(self)->value;
+  }
+
+  static Value local(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    return engine.frame[as<VarExpr>(self)->slot];
+  }
+
+  static Value cell(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    return cellValue(engine.frame[as<VarExpr>(self)->slot]);
+  }
+
+  static Value upvalue(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    return engine.function->getUpvalue(as<VarExpr>(self)->slot)->value;
+  }
+
+  static Value global(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const VarExpr* node = as<VarExpr>(self);
+    return engine.globals.get(node->slot, *node->name);
+  }
+
+  static Value assignLocal(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const AssignExpr* node = as<AssignExpr>(self);
+    Value value = node->value->eval(node->value, engine);
+    engine.frame[node->slot] = value;
+    return value;
+  }
+
+  static Value assignCell(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const AssignExpr* node = as<AssignExpr>(self);
+    Value value = node->value->eval(node->value, engine);
+    cellValue(engine.frame[node->slot]) = value;
+    return value;
+  }
+
+  static Value assignUpvalue(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const AssignExpr* node = as<AssignExpr>(self);
+    Value value = node->value->eval(node->value, engine);
+    engine.function->getUpvalue(node->slot)->value = value;
+    return value;
+  }
+
+  static Value assignGlobal(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const AssignExpr* node = as<AssignExpr>(self);
+    Value value = node->value->eval(node->value, engine);
+    engine.globals.assign(node->slot, *node->name, value);
+    return value;
+  }
+
+  static Value notOp(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const UnaryExpr* node = as<UnaryExpr>(self);
+    return !node->right->test(node->right, engine);
+  }
+
+  static bool notTest(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const UnaryExpr* node = as<UnaryExpr>(self);
+    return !node->right->test(node->right, engine);
+  }
+
+  static Value negate(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const UnaryExpr* node = as<UnaryExpr>(self);
+    Value right = node->right->eval(node->right, engine);
+    if (!right.isNumber())
+      throw std::make_pair(*node->op, std::string("Operand must be a number."));
+    return -right.asNumber();
+  }
+
+  static Value andOp(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const LogicalExpr* node = as<LogicalExpr>(self);
+    Value left = node->left->eval(node->left, engine);
+    if (!isTruthy(left))
+      return left;
+    return node->right->eval(node->right, engine);
+  }
+
+  static bool andTest(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const LogicalExpr* node = as<LogicalExpr>(self);
+    return node->left->test(node->left, engine) && node->right->test(node->right, engine);
+  }
+
+  static Value orOp(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const LogicalExpr* node = as<LogicalExpr>(self);
+    Value left = node->left->eval(node->left, engine);
+    if (isTruthy(left))
+      return left;
+    return node->right->eval(node->right, engine);
+  }
+
+  static bool orTest(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const LogicalExpr* node = as<LogicalExpr>(self);
+    return node->left->test(node->left, engine) || node->right->test(node->right, engine);
+  }
+
+  /* an operand by reference when it's already somewhere, a temporary when it has to be evaluated */
+  template <OperandKind kind>
+  static decltype(auto) read(const Operand& operand, ClosureEngine& engine)
+  {
+    if constexpr (kind == OPERAND_LOCAL)
+      return static_cast<const Value&>(engine.frame[operand.slot]);
+    else if constexpr (kind == OPERAND_CONST)
+      return static_cast<const Value&>(operand.value);
+    else
+      return operand.expr->eval(operand.expr, engine);
+  }
+
+  template <TokenType op>
+  static bool compare(const Value& left, const Value& right, const Token* token)
+  {
+    if constexpr (op == EQUAL_EQUAL)
+      return isEqual(left, right);
+    else if constexpr (op == BANG_EQUAL)
+      return !isEqual(left, right);
+    else
+    {
+      if (!left.isNumber() || !right.isNumber())
+        numbersError(token);
+      if constexpr (op == GREATER)            return left.asNumber() > right.asNumber();
+      else if constexpr (op == GREATER_EQUAL) return left.asNumber() >= right.asNumber();
+      else if constexpr (op == LESS)          return left.asNumber() < right.asNumber();
+      else                                    return left.asNumber() <= right.asNumber();
+    }
+  }
+
+  template <TokenType op>
+  static Value arithmetic(const Value& left, const Value& right, const Token* token)
+  {
+    if constexpr (op == PLUS)
+    {
+      if (left.isNumber() && right.isNumber())
+        return left.asNumber() + right.asNumber();
+      return addValues(*token, left, right);
+    }
+    else
+    {
+      if (!left.isNumber() || !right.isNumber())
+        numbersError(token);
+      if constexpr (op == MINUS)
+        return left.asNumber() - right.asNumber();
+      else if constexpr (op == STAR)
+        return left.asNumber() * right.asNumber();
+      else
+      {
+        if (right.asNumber() == 0)
+          throw std::make_pair(*token, std::string("Check your math big man!! you cant divide a number by 0"));
+        return left.asNumber() / right.asNumber();
+      }
+    }
+  }
+
+  static constexpr bool isComparison(TokenType op)
+  {
+    return op == EQUAL_EQUAL || op == BANG_EQUAL || op == GREATER ||
+           op == GREATER_EQUAL || op == LESS || op == LESS_EQUAL;
+  }
+
+  template <TokenType op, OperandKind L, OperandKind R>
+  static Value binary(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const BinaryExpr* node = as<BinaryExpr>(self);
+    const Value& left = read<L>(node->left, engine);
+    const Value& right = read<R>(node->right, engine);
+    if constexpr (isComparison(op))
+      return compare<op>(left, right, node->op);
+    else
+      return arithmetic<op>(left, right, node->op);
+  }
+
+  template <TokenType op, OperandKind L, OperandKind R>
+  static bool binaryTest(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const BinaryExpr* node = as<BinaryExpr>(self);
+    const Value& left = read<L>(node->left, engine);
+    const Value& right = read<R>(node->right, engine);
+    return compare<op>(left, right, node->op);
+  }
+
+  template <TokenType op, OperandKind L, OperandKind R>
+  static void bind(BinaryExpr* node)
+  {
+    node->eval = binary<op, L, R>;
+    if constexpr (isComparison(op))
+      node->test = binaryTest<op, L, R>;
+  }
+
+  /* the left operand is only read in place when the right one can't assign to it */
+  template <TokenType op>
+  static void bind(BinaryExpr* node)
+  {
+    switch (node->left.kind * 3 + node->right.kind)
+    {
+    case OPERAND_ANY * 3 + OPERAND_LOCAL:     bind<op, OPERAND_ANY, OPERAND_LOCAL>(node); break;
+    case OPERAND_ANY * 3 + OPERAND_CONST:     bind<op, OPERAND_ANY, OPERAND_CONST>(node); break;
+    case OPERAND_LOCAL * 3 + OPERAND_LOCAL:   bind<op, OPERAND_LOCAL, OPERAND_LOCAL>(node); break;
+    case OPERAND_LOCAL * 3 + OPERAND_CONST:   bind<op, OPERAND_LOCAL, OPERAND_CONST>(node); break;
+    case OPERAND_CONST * 3 + OPERAND_ANY:     bind<op, OPERAND_CONST, OPERAND_ANY>(node); break;
+    case OPERAND_CONST * 3 + OPERAND_LOCAL:   bind<op, OPERAND_CONST, OPERAND_LOCAL>(node); break;
+    case OPERAND_CONST * 3 + OPERAND_CONST:   bind<op, OPERAND_CONST, OPERAND_CONST>(node); break;
+    default:                                  bind<op, OPERAND_ANY, OPERAND_ANY>(node); break;
+    }
+  }
+
+  static void bind(BinaryExpr* node)
+  {
+    switch (node->op->type)
+    {
+    case BANG_EQUAL:    bind<BANG_EQUAL>(node); break;
+    case EQUAL_EQUAL:   bind<EQUAL_EQUAL>(node); break;
+    case GREATER:       bind<GREATER>(node); break;
+    case GREATER_EQUAL: bind<GREATER_EQUAL>(node); break;
+    case LESS:          bind<LESS>(node); break;
+    case LESS_EQUAL:    bind<LESS_EQUAL>(node); break;
+    case MINUS:         bind<MINUS>(node); break;
+    case STAR:          bind<STAR>(node); break;
+    case SLASH:         bind<SLASH>(node); break;
+    default:            bind<PLUS>(node); break;
+    }
+  }
+
+  static Value call(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    const CallExpr* node = as<CallExpr>(self);
+    Value callee = node->callee->eval(node->callee, engine);
+    Value* args = engine.pushArgs(node);
+    Callable* function = engine.checkCall(node, callee, args, args);
+    stats.calls++;
+    Completion completion = engine.callFunction(function, args);
+    if (completion.type == COMPLETION_RETURN)
+      return std::move(completion.value);
+    return Value();
+  }
+
+  static Value lambda(const CompiledExpr* self, ClosureEngine& engine)
+  {
+    return Callable::closure(*as<LambdaExpr>(self)->info, nullptr, engine.frame, engine.function);
+  }
+
+  static Completion expression(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const ExprStmt* node = as<ExprStmt>(self);
+    node->expr->eval(node->expr, engine);
+    return Completion();
+  }
+
+  static Completion print(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const ExprStmt* node = as<ExprStmt>(self);
+    engine.print(node->expr->eval(node->expr, engine));
+    return Completion();
+  }
+
+  /* value is null for var x; */
+  static Value storedValue(const StoreStmt* node, ClosureEngine& engine)
+  {
+    if (node->value == nullptr)
+      return Value();
+    return node->value->eval(node->value, engine);
+  }
+
+  static Completion defineLocal(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const StoreStmt* node = as<StoreStmt>(self);
+    engine.frame[node->slot] = storedValue(node, engine);
+    return Completion();
+  }
+
+  static Completion defineCell(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const StoreStmt* node = as<StoreStmt>(self);
+    engine.frame[node->slot] = Value(new Cell(storedValue(node, engine)));
+    return Completion();
+  }
+
+  static Completion defineGlobal(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const StoreStmt* node = as<StoreStmt>(self);
+    engine.globals.define(node->slot, storedValue(node, engine));
+    return Completion();
+  }
+
+  /* x = y; as a statement, no copy of the value for the result */
+  static Completion storeGlobal(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const StoreStmt* node = as<StoreStmt>(self);
+    engine.globals.assign(node->slot, *node->name, node->value->eval(node->value, engine));
+    return Completion();
+  }
+
+  static Completion function(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const FunctionStmt* node = as<FunctionStmt>(self);
+    engine.frame[node->slot] = Callable::closure(*node->info, node->name, engine.frame, engine.function);
+    return Completion();
+  }
+
+  /* a local function that calls itself captures its own cell, so make that first */
+  static Completion functionCell(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const FunctionStmt* node = as<FunctionStmt>(self);
+    Cell* cell = new Cell(Value());
+    engine.frame[node->slot] = Value(cell);
+    cell->value = Callable::closure(*node->info, node->name, engine.frame, engine.function);
+    return Completion();
+  }
+
+  static Completion functionGlobal(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const FunctionStmt* node = as<FunctionStmt>(self);
+    engine.globals.define(node->slot, Callable::closure(*node->info, node->name, engine.frame, engine.function));
+    return Completion();
+  }
+
+  static Completion block(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    for (const CompiledStmt* statement : as<BlockStmt>(self)->statements)
+    {
+      Completion completion = statement->exec(statement, engine);
+      if (completion.type != COMPLETION_NORMAL)
+        return completion;
+    }
+    return Completion();
+  }
+
+  static Completion ifStmt(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const IfStmt* node = as<IfStmt>(self);
+    if (node->condition->test(node->condition, engine))
+      return node->thenBranch->exec(node->thenBranch, engine);
+    if (node->elseBranch != nullptr)
+      return node->elseBranch->exec(node->elseBranch, engine);
+    return Completion();
+  }
+
+  static Completion whileStmt(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const WhileStmt* node = as<WhileStmt>(self);
+    while (node->condition->test(node->condition, engine))
+    {
+      Completion completion = node->body->exec(node->body, engine);
+      if (completion.type == COMPLETION_BREAK)
+        break;
+      if (completion.type == COMPLETION_RETURN || completion.type == COMPLETION_TAIL_CALL)
+        return completion;
+    }
+    return Completion();
+  }
+
+  static Completion returnStmt(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const ReturnStmt* node = as<ReturnStmt>(self);
+    return { COMPLETION_RETURN, node->value->eval(node->value, engine) };
+  }
+
+  /* the args go on the stack, callFunction makes the call in the current frame */
+  static Completion tailCall(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    const CallExpr* call = as<CallExpr>(as<ReturnStmt>(self)->value);
+    Value callee = call->callee->eval(call->callee, engine);
+    Value* args = engine.pushArgs(call);
+    engine.checkCall(call, callee, args, engine.frame);
+    return { COMPLETION_TAIL_CALL, std::move(callee) };
+  }
+
+  static Completion breakStmt(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    return { COMPLETION_BREAK };
+  }
+
+  static Completion continueStmt(const CompiledStmt* self, ClosureEngine& engine)
+  {
+    return { COMPLETION_CONTINUE };
+  }
+};
+
+/*
+ * Builds the closures for a resolved program, the Resolver already
+ * worked out where every variable lives. Function bodies are compiled
+ * when their declaration is.
+ */
+class ClosureCompiler : public ExprVisitor<Value>, public StmtVisitor<Completion>
+{
+public:
+  ClosureCompiler(std::vector<std::unique_ptr<CompiledExpr>>& exprs, std::vector<std::unique_ptr<CompiledStmt>>& stmts)
+    : exprs(exprs), stmts(stmts)
+  {}
+
+  CompiledExpr* compile(Expr& expr)
+  {
+    expr.accept(*this);
+    if (lastExpr->test == nullptr)
+      lastExpr->test = Closures::truthy;
+    return lastExpr;
+  }
+
+  CompiledStmt* compile(Stmt& stmt)
+  {
+    stmt.accept(*this);
+    return lastStmt;
+  }
+
+  CompiledStmt* compile(const std::vector<std::unique_ptr<Stmt>>& statements)
+  {
+    BlockStmt* node = make<BlockStmt>(Closures::block);
+    for (const auto& statement : statements)
+    {
+      if (statement != nullptr)
+        node->statements.push_back(compile(*statement));
+    }
+    lastStmt = node;
+    return node;
+  }
+private:
+  template <typename T>
+  T* make(typename CompiledExpr::Eval eval)
+  {
+    exprs.push_back(std::make_unique<T>());
+    T* node = static_cast<T*>(exprs.back().get());
+    node->eval = eval;
+    lastExpr = node;
+    return node;
+  }
+
+  template <typename T>
+  T* make(typename CompiledStmt::Exec exec)
+  {
+    stmts.push_back(std::make_unique<T>());
+    T* node = static_cast<T*>(stmts.back().get());
+    node->exec = exec;
+    lastStmt = node;
+    return node;
+  }
+
+  void compileFunction(FunctionInfo& info)
+  {
+    if (info.compiled == nullptr)
+      info.compiled = compile(info.getBody());
+  }
+
+  Operand operand(Expr& expr)
+  {
+    Operand operand;
+    if (Literal* literal = dynamic_cast<Literal*>(&expr))
+    {
+      operand.kind = OPERAND_CONST;
+      operand.value = literal->getLit();
+    }
+    else if (Variable* variable = dynamic_cast<Variable*>(&expr); variable != nullptr && variable->getRef().kind == VAR_LOCAL)
+    {
+      operand.kind = OPERAND_LOCAL;
+      operand.slot = variable->getRef().index;
+    }
+    else
+      operand.expr = compile(expr);
+    return operand;
+  }
+
+  CallExpr* compileCall(Call& expr)
+  {
+    CompiledExpr* callee = compile(expr.getCallee());
+    std::vector<CompiledExpr*> args;
+    for (const auto& arg : expr.getArgs())
+      args.push_back(compile(*arg));
+    CallExpr* node = make<CallExpr>(Closures::call);
+    node->paren = &expr.getParen();
+    node->callee = callee;
+    node->args = std::move(args);
+    return node;
+  }
+
+  StoreStmt* define(const VarDecl& decl, CompiledExpr* value)
+  {
+    CompiledStmt::Exec exec = Closures::defineLocal;
+    if (decl.global)
+      exec = Closures::defineGlobal;
+    else if (decl.boxed)
+      exec = Closures::defineCell;
+    StoreStmt* node = make<StoreStmt>(exec);
+    node->slot = decl.slot;
+    node->name = nullptr;
+    node->value = value;
+    return node;
+  }
+
+  Completion visitReturnStmt(Return& stmt) override
+  {
+    if (stmt.isTailCall())
+    {
+      CallExpr* call = compileCall(static_cast<Call&>(stmt.getValue()));
+      make<ReturnStmt>(Closures::tailCall)->value = call;
+      return Completion();
+    }
+    CompiledExpr* value = compile(stmt.getValue());
+    make<ReturnStmt>(Closures::returnStmt)->value = value;
+    return Completion();
+  }
+
+  Completion visitFunctionStmt(Function& stmt) override
+  {
+    compileFunction(stmt.getInfo());
+    const VarDecl& decl = stmt.getDecl();
+    CompiledStmt::Exec exec = Closures::function;
+    if (decl.global)
+      exec = Closures::functionGlobal;
+    else if (decl.boxed)
+      exec = Closures::functionCell;
+    FunctionStmt* node = make<FunctionStmt>(exec);
+    node->slot = decl.slot;
+    node->info = &stmt.getInfo();
+    node->name = &stmt.getName();
+    return Completion();
+  }
+
+  Completion visitBreakStmt(Break& stmt) override
+  {
+    make<CompiledStmt>(Closures::breakStmt);
+    return Completion();
+  }
+
+  Completion visitContinueStmt(Continue& stmt) override
+  {
+    make<CompiledStmt>(Closures::continueStmt);
+    return Completion();
+  }
+
+  Completion visitWhileStmt(While& stmt) override
+  {
+    CompiledExpr* condition = compile(stmt.getCondition());
+    CompiledStmt* body = compile(stmt.getBody());
+    WhileStmt* node = make<WhileStmt>(Closures::whileStmt);
+    node->condition = condition;
+    node->body = body;
+    return Completion();
+  }
+
+  Completion visitIfStmt(If& stmt) override
+  {
+    CompiledExpr* condition = compile(stmt.getCondition());
+    CompiledStmt* thenBranch = compile(stmt.getThen());
+    CompiledStmt* elseBranch = stmt.hasElse() ? compile(stmt.getElse()) : nullptr;
+    IfStmt* node = make<IfStmt>(Closures::ifStmt);
+    node->condition = condition;
+    node->thenBranch = thenBranch;
+    node->elseBranch = elseBranch;
+    return Completion();
+  }
+
+  Completion visitExpressionStmt(Expression& stmt) override
+  {
+    /* x = y; as a statement doesn't need the assignment's result */
+    Assign* assign = dynamic_cast<Assign*>(&stmt.getExpr());
+    if (assign != nullptr && (assign->getRef().kind == VAR_LOCAL || assign->getRef().kind == VAR_GLOBAL))
+    {
+      CompiledExpr* value = compile(assign->getValue());
+      bool global = assign->getRef().kind == VAR_GLOBAL;
+      StoreStmt* node = make<StoreStmt>(global ? Closures::storeGlobal : Closures::defineLocal);
+      node->slot = assign->getRef().index;
+      node->name = &assign->getName();
+      node->value = value;
+      return Completion();
+    }
+
+    CompiledExpr* expr = compile(stmt.getExpr());
+    make<ExprStmt>(Closures::expression)->expr = expr;
+    return Completion();
+  }
+
+  Completion visitPrintStmt(Print& stmt) override
+  {
+    CompiledExpr* expr = compile(stmt.getExpr());
+    make<ExprStmt>(Closures::print)->expr = expr;
+    return Completion();
+  }
+
+  Completion visitVarStmt(Var& stmt) override
+  {
+    CompiledExpr* value = stmt.hasInitializer() ? compile(stmt.getInitializer()) : nullptr;
+    define(stmt.getDecl(), value);
+    return Completion();
+  }
+
+  Completion visitBlockStmt(Block& stmt) override
+  {
+    compile(stmt.getStatements());
+    return Completion();
+  }
+
+  Value visitCallExpr(Call& expr) override
+  {
+    compileCall(expr);
+    return Value();
+  }
+
+  Value visitLogicalExpr(Logical& expr) override
+  {
+    CompiledExpr* left = compile(expr.getLeft());
+    CompiledExpr* right = compile(expr.getRight());
+    bool isOr = expr.getOp().type == OR;
+    LogicalExpr* node = make<LogicalExpr>(isOr ? Closures::orOp : Closures::andOp);
+    node->test = isOr ? Closures::orTest : Closures::andTest;
+    node->left = left;
+    node->right = right;
+    return Value();
+  }
+
+  Value visitBinaryExpr(Binary& expr) override
+  {
+    Operand left = operand(expr.getLeft());
+    Operand right = operand(expr.getRight());
+    /* reading a local in place would see an assignment to it made by the right side */
+    if (left.kind == OPERAND_LOCAL && right.kind == OPERAND_ANY)
+      left.expr = compile(expr.getLeft()), left.kind = OPERAND_ANY;
+    BinaryExpr* node = make<BinaryExpr>(CompiledExpr::Eval(nullptr));
+    node->op = &expr.getOp();
+    node->left = std::move(left);
+    node->right = std::move(right);
+    Closures::bind(node);
+    return Value();
+  }
+
+  Value visitGroupingExpr(Grouping& expr) override
+  {
+    compile(expr.getExpr());
+    return Value();
+  }
+
+  Value visitLiteralExpr(Literal& expr) override
+  {
+    make<ConstExpr>(Closures::constant)->value = expr.getLit();
+    return Value();
+  }
+
+  Value visitUnaryExpr(Unary& expr) override
+  {
+    CompiledExpr* right = compile(expr.getRight());
+    bool isNot = expr.getOp().type == BANG;
+    UnaryExpr* node = make<UnaryExpr>(isNot ? Closures::notOp : Closures::negate);
+    if (isNot)
+      node->test = Closures::notTest;
+    node->op = &expr.getOp();
+    node->right = right;
+    return Value();
+  }
+
+  Value visitVariableExpr(Variable& expr) override
+  {
+    const VarRef& ref = expr.getRef();
+    CompiledExpr::Eval eval = Closures::global;
+    switch (ref.kind)
+    {
+    case VAR_LOCAL:   eval = Closures::local; break;
+    case VAR_CELL:    eval = Closures::cell; break;
+    case VAR_UPVALUE: eval = Closures::upvalue; break;
+    default:          break;
+    }
+    VarExpr* node = make<VarExpr>(eval);
+    node->slot = ref.index;
+    node->name = &expr.getName();
+    return Value();
+  }
+
+  Value visitAssignExpr(Assign& expr) override
+  {
+    CompiledExpr* value = compile(expr.getValue());
+    const VarRef& ref = expr.getRef();
+    CompiledExpr::Eval eval = Closures::assignGlobal;
+    switch (ref.kind)
+    {
+    case VAR_LOCAL:   eval = Closures::assignLocal; break;
+    case VAR_CELL:    eval = Closures::assignCell; break;
+    case VAR_UPVALUE: eval = Closures::assignUpvalue; break;
+    default:          break;
+    }
+    AssignExpr* node = make<AssignExpr>(eval);
+    node->slot = ref.index;
+    node->name = &expr.getName();
+    node->value = value;
+    return Value();
+  }
+
+  Value visitLambdaExpr(Lambda& expr) override
+  {
+    compileFunction(expr.getInfo());
+    make<LambdaExpr>(Closures::lambda)->info = &expr.getInfo();
+    return Value();
+  }
+private:
+  std::vector<std::unique_ptr<CompiledExpr>>& exprs;
+  std::vector<std::unique_ptr<CompiledStmt>>& stmts;
+  CompiledExpr* lastExpr = nullptr;
+  CompiledStmt* lastStmt = nullptr;
+};
+
+ClosureEngine::ClosureEngine()
+  : stack(STACK_SIZE)
+{
+  stackTop = stack.data();
+}
+
+/* out of line, the node types are only complete in here */
+ClosureEngine::~ClosureEngine() = default;
+
+void ClosureEngine::interpret(std::unique_ptr<Program> program, int slotCount)
+{
+  programs.push_back(std::move(program));
+  ClosureCompiler compiler(exprs, stmts);
+  std::vector<CompiledStmt*> compiled;
+  for (auto& statement : programs.back()->statements)
+    compiled.push_back(compiler.compile(*statement));
+
+  /* locals of top-level blocks */
+  Value* scriptFrame = stack.data();
+  stackTop = scriptFrame + slotCount;
+  frame = scriptFrame;
+  function = nullptr;
+  callDepth = 0;
+  uint64_t allocations = stats.allocations;
+  memory.beginRun();
+  try
+  {
+    for (CompiledStmt* statement : compiled)
+      statement->exec(statement, *this);
+  }
+  catch (std::pair<Token, std::string>& tokStr)
+  {
+    reportError(tokStr.first, tokStr.second);
+  }
+  catch (MemoryLimitError& error)
+  {
+    reportError(memoryLimitMessage(error.limit));
+  }
+  popFrame(scriptFrame);
+  memory.endRun();
+  stats.interpreterAllocations += stats.allocations - allocations;
+}
+
+/* releases everything from base up and makes it the new top */
+void ClosureEngine::popFrame(Value* base)
+{
+  while (stackTop > base)
+    *--stackTop = Value();
+}
+
+/* the args go straight into the first slots of the callee's frame */
+Value* ClosureEngine::pushArgs(const CallExpr* call)
+{
+  Value* args = stackTop;
+  Value* stackEnd = stack.data() + stack.size();
+  for (const CompiledExpr* arg : call->args)
+  {
+    Value value = arg->eval(arg, *this);
+    if (stackTop == stackEnd)
+      throw std::make_pair(*call->paren, std::string("Stack overflow."));
+    *stackTop++ = std::move(value);
+  }
+  return args;
+}
+
+/* frame is where the callee's frame will start, args for a normal call */
+Callable* ClosureEngine::checkCall(const CallExpr* call, const Value& callee, Value* args, Value* frame)
+{
+  Callable* function;
+  if (callee.isCallable() && &callee.asCallable()->getInfo() == call->cache.info)
+  {
+    stats.callCacheHits++;
+    function = callee.asCallable();
+  }
+  else
+  {
+    if (!callee.isCallable())
+      throw std::make_pair(*call->paren, std::string("Object called is not a function"));
+
+    function = callee.asCallable();
+    if (stackTop - args != function->getArity())
+      throw std::make_pair(*call->paren, std::string("Invalid number of arguments"));
+    stats.callCacheMisses++;
+    call->cache.info = &function->getInfo();
+  }
+
+  if (stack.data() + stack.size() - frame < function->getInfo().slotCount || callDepth == MAX_CALL_DEPTH)
+    throw std::make_pair(*call->paren, std::string("Stack overflow."));
+  if (!memory.fitsFrame(frameBytes(function->getInfo())))
+    throw std::make_pair(*call->paren, memoryLimitMessage(memory.getLimit()));
+  return function;
+}
+
+/* same as Interpreter::executeFunction, tail calls loop here instead of recursing */
+Completion ClosureEngine::callFunction(Callable* function, Value* frame)
+{
+  Value* previousFrame = this->frame;
+  Callable* previousFunction = this->function;
+  this->frame = frame;
+  callDepth++;
+  memory.pushFrame(frameBytes(function->getInfo()));
+
+  Value tailCallee;
+  Completion completion;
+  for (;;)
+  {
+    FunctionInfo& info = function->getInfo();
+    this->function = function;
+    stackTop = frame + info.slotCount;
+    for (int slot : info.boxedParams)
+      frame[slot] = Value(new Cell(frame[slot]));
+
+    completion = info.compiled->exec(info.compiled, *this);
+    if (completion.type != COMPLETION_TAIL_CALL)
+      break;
+
+    memory.popFrame(frameBytes(function->getInfo()));
+    tailCallee = std::move(completion.value);
+    function = tailCallee.asCallable();
+    memory.pushFrame(frameBytes(function->getInfo()));
+    Value* args = stackTop - function->getArity();
+    for (int i = 0; i < function->getArity(); i++)
+      frame[i] = std::move(args[i]);
+    popFrame(frame + function->getArity());
+    stats.calls++;
+  }
+
+  popFrame(frame);
+  memory.popFrame(frameBytes(function->getInfo()));
+  callDepth--;
+  this->frame = previousFrame;
+  this->function = previousFunction;
+  return completion;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Engine.h"
+
+struct CompiledExpr;
+struct CompiledStmt;
+struct CallExpr;
+class Callable;
+
+/*
+ * --engine=closure. Every AST node is turned once into a small struct
+ * holding a pointer to a C++ function made for that kind of node (its
+ * closure) plus its children's closures, so running a node is a single
+ * indirect call instead of accept() + visitXxx(). Common shapes get a
+ * fused closure: local + constant reads both operands itself instead of
+ * calling two children, and a comparison used as a condition tests the
+ * numbers without making a bool Value. Frames and calls work like the
+ * tree walker's.
+ */
+class ClosureEngine : public Engine
+{
+public:
+	ClosureEngine();
+	~ClosureEngine();
+	void interpret(std::unique_ptr<Program> program, int slotCount) override;
+private:
+	/* the closures in ClosureEngine.cpp, they run against the state below */
+	friend struct Closures;
+	Completion callFunction(Callable* function, Value* frame);
+	Value* pushArgs(const CallExpr* call);
+	Callable* checkCall(const CallExpr* call, const Value& callee, Value* args, Value* frame);
+	void popFrame(Value* base);
+private:
+	/* every compiled node, FunctionInfo::compiled points in here */
+	std::vector<std::unique_ptr<CompiledExpr>> exprs;
+	std::vector<std::unique_ptr<CompiledStmt>> stmts;
+	/* same frame stack as the tree walker, slots above stackTop are nil */
+	std::vector<Value> stack;
+	Value* stackTop;
+	int callDepth = 0;
+	Value* frame = nullptr;
+	/* the running closure, null at top level */
+	Callable* function = nullptr;
+};
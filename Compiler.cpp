@@ -0,0 +1,389 @@
+#include "Compiler.h"
+#include <cstring>
+#include <utility>
+
+Chunk* Compiler::newChunk()
+{
+  chunks.push_back(std::make_unique<Chunk>());
+  return chunks.back().get();
+}
+
+Chunk* Compiler::compile(const std::list<std::unique_ptr<Stmt>>& statements)
+{
+  chunk = newChunk();
+  loop = nullptr;
+  depth = 0;
+  numbers.clear();
+  for (const auto& statement : statements)
+    compile(*statement);
+  emit(OP_RETURN_NIL, 0);
+  return chunk;
+}
+
+void Compiler::compileFunction(FunctionInfo& info)
+{
+  Chunk* enclosingChunk = chunk;
+  Loop* enclosingLoop = loop;
+  int enclosingDepth = depth;
+  std::unordered_map<uint64_t, int> enclosingNumbers = std::move(numbers);
+  chunk = newChunk();
+  info.chunk = chunk;
+  loop = nullptr;
+  depth = 0;
+  numbers.clear();
+
+  compile(info.getBody());
+  emit(OP_RETURN_NIL, 0);
+
+  chunk = enclosingChunk;
+  loop = enclosingLoop;
+  depth = enclosingDepth;
+  numbers = std::move(enclosingNumbers);
+}
+
+void Compiler::compile(const std::vector<std::unique_ptr<Stmt>>& statements)
+{
+  for (const auto& statement : statements)
+  {
+    if (statement != nullptr)
+      compile(*statement);
+  }
+}
+
+void Compiler::compile(Stmt& stmt)
+{
+  stmt.accept(*this);
+}
+
+void Compiler::compile(Expr& expr)
+{
+  expr.accept(*this);
+}
+
+void Compiler::emit(OpCode op, int stackEffect)
+{
+  chunk->code.push_back(op);
+  depth += stackEffect;
+  chunk->maxStack = std::max(chunk->maxStack, depth);
+}
+
+void Compiler::emit(OpCode op, int operand, int stackEffect)
+{
+  if (operand > MAX_OPERAND)
+    tooBig("Too many variables or constants in one function.");
+  emit(op, stackEffect);
+  chunk->code.push_back(operand & 0xff);
+  chunk->code.push_back((operand >> 8) & 0xff);
+  chunk->code.push_back(operand >> 16);
+}
+
+/* returns where the operand goes, patchJump fills it in */
+int Compiler::emitJump(OpCode op, int stackEffect)
+{
+  emit(op, 0, stackEffect);
+  return chunk->code.size() - OPERAND_SIZE;
+}
+
+void Compiler::patchJump(int offset)
+{
+  int jump = chunk->code.size() - offset - OPERAND_SIZE;
+  if (jump > MAX_OPERAND)
+    tooBig("Too much code to jump over.");
+  chunk->code[offset] = jump & 0xff;
+  chunk->code[offset + 1] = (jump >> 8) & 0xff;
+  chunk->code[offset + 2] = jump >> 16;
+}
+
+void Compiler::emitLoop(int start)
+{
+  int jump = chunk->code.size() + 1 + OPERAND_SIZE - start;
+  if (jump > MAX_OPERAND)
+    tooBig("Loop body too large.");
+  emit(OP_LOOP, jump, 0);
+}
+
+/* the next instruction can fail, errors point at token */
+void Compiler::mark(const Token& token)
+{
+  chunk->tokens.push_back({ (int)chunk->code.size(), &token });
+  this->token = &token;
+}
+
+void Compiler::tooBig(const char* msg)
+{
+  static const Token nowhere(_EOF_, "", {}, 0);
+  throw std::make_pair(token != nullptr ? *token : nowhere, std::string(msg));
+}
+
+int Compiler::addConstant(const Value& value)
+{
+  if (value.isNumber())
+  {
+    /* by the bits, 0 and -0 stay apart */
+    double number = value.asNumber();
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof(bits));
+    auto [it, added] = numbers.try_emplace(bits, (int)chunk->constants.size());
+    if (!added)
+      return it->second;
+  }
+  chunk->constants.push_back(value);
+  return chunk->constants.size() - 1;
+}
+
+void Compiler::define(const VarDecl& decl)
+{
+  if (decl.global)
+    emit(OP_DEFINE_GLOBAL, decl.slot, -1);
+  else if (decl.boxed)
+    emit(OP_DEFINE_CELL, decl.slot, -1);
+  else
+    emit(OP_DEFINE_LOCAL, decl.slot, -1);
+}
+
+Completion Compiler::visitReturnStmt(Return& stmt)
+{
+  if (stmt.isTailCall())
+  {
+    Call& call = static_cast<Call&>(stmt.getValue());
+    compile(call.getCallee());
+    for (const auto& arg : call.getArgs())
+      compile(*arg);
+    mark(call.getParen());
+    emit(OP_TAIL_CALL, call.getArgs().size(), -(int)call.getArgs().size() - 1);
+    return Completion();
+  }
+
+  compile(stmt.getValue());
+  emit(OP_RETURN, -1);
+  return Completion();
+}
+
+Completion Compiler::visitFunctionStmt(Function& stmt)
+{
+  compileFunction(stmt.getInfo());
+  chunk->functions.push_back({ &stmt.getInfo(), &stmt.getName() });
+  int function = chunk->functions.size() - 1;
+
+  const VarDecl& decl = stmt.getDecl();
+  if (!decl.global && decl.boxed)
+  {
+    /* a local function that calls itself captures its own cell, so make that first */
+    emit(OP_NEW_CELL, decl.slot, 0);
+    emit(OP_CLOSURE, function, 1);
+    emit(OP_SET_CELL, decl.slot, 0);
+    emit(OP_POP, -1);
+    return Completion();
+  }
+  emit(OP_CLOSURE, function, 1);
+  define(decl);
+  return Completion();
+}
+
+Completion Compiler::visitBreakStmt(Break& stmt)
+{
+  loop->breaks.push_back(emitJump(OP_JUMP, 0));
+  return Completion();
+}
+
+Completion Compiler::visitContinueStmt(Continue& stmt)
+{
+  emitLoop(loop->start);
+  return Completion();
+}
+
+Completion Compiler::visitWhileStmt(While& stmt)
+{
+  Loop current = { loop, (int)chunk->code.size() };
+  loop = &current;
+
+  compile(stmt.getCondition());
+  int exit = emitJump(OP_JUMP_IF_FALSE, -1);
+  compile(stmt.getBody());
+  emitLoop(current.start);
+
+  patchJump(exit);
+  for (int jump : current.breaks)
+    patchJump(jump);
+  loop = current.enclosing;
+  return Completion();
+}
+
+Completion Compiler::visitIfStmt(If& stmt)
+{
+  compile(stmt.getCondition());
+  int thenJump = emitJump(OP_JUMP_IF_FALSE, -1);
+  compile(stmt.getThen());
+  if (!stmt.hasElse())
+  {
+    patchJump(thenJump);
+    return Completion();
+  }
+
+  int elseJump = emitJump(OP_JUMP, 0);
+  patchJump(thenJump);
+  compile(stmt.getElse());
+  patchJump(elseJump);
+  return Completion();
+}
+
+Completion Compiler::visitExpressionStmt(Expression& stmt)
+{
+  /* x = y; as a statement stores without leaving x on the stack just to pop it */
+  Assign* assign = dynamic_cast<Assign*>(&stmt.getExpr());
+  if (assign != nullptr && assign->getRef().kind == VAR_LOCAL)
+  {
+    compile(assign->getValue());
+    emit(OP_DEFINE_LOCAL, assign->getRef().index, -1);
+    return Completion();
+  }
+  if (assign != nullptr && assign->getRef().kind == VAR_GLOBAL)
+  {
+    compile(assign->getValue());
+    mark(assign->getName());
+    emit(OP_STORE_GLOBAL, assign->getRef().index, -1);
+    return Completion();
+  }
+
+  compile(stmt.getExpr());
+  emit(OP_POP, -1);
+  return Completion();
+}
+
+Completion Compiler::visitPrintStmt(Print& stmt)
+{
+  compile(stmt.getExpr());
+  emit(OP_PRINT, -1);
+  return Completion();
+}
+
+Completion Compiler::visitVarStmt(Var& stmt)
+{
+  if (stmt.hasInitializer())
+    compile(stmt.getInitializer());
+  else
+    emit(OP_NIL, 1);
+  define(stmt.getDecl());
+  return Completion();
+}
+
+Completion Compiler::visitBlockStmt(Block& stmt)
+{
+  compile(stmt.getStatements());
+  return Completion();
+}
+
+Value Compiler::visitCallExpr(Call& expr)
+{
+  compile(expr.getCallee());
+  for (const auto& arg : expr.getArgs())
+    compile(*arg);
+  mark(expr.getParen());
+  emit(OP_CALL, expr.getArgs().size(), -(int)expr.getArgs().size());
+  return Value();
+}
+
+Value Compiler::visitLogicalExpr(Logical& expr)
+{
+  compile(expr.getLeft());
+  int jump = emitJump(expr.getOp().type == OR ? OP_OR : OP_AND, -1);
+  compile(expr.getRight());
+  patchJump(jump);
+  return Value();
+}
+
+Value Compiler::visitBinaryExpr(Binary& expr)
+{
+  compile(expr.getLeft());
+  compile(expr.getRight());
+
+  OpCode op;
+  switch (expr.getOp().type)
+  {
+  case BANG_EQUAL:    emit(OP_NOT_EQUAL, -1); return Value();
+  case EQUAL_EQUAL:   emit(OP_EQUAL, -1); return Value();
+  case GREATER:       op = OP_GREATER; break;
+  case GREATER_EQUAL: op = OP_GREATER_EQUAL; break;
+  case LESS:          op = OP_LESS; break;
+  case LESS_EQUAL:    op = OP_LESS_EQUAL; break;
+  case MINUS:         op = OP_SUBTRACT; break;
+  case STAR:          op = OP_MULTIPLY; break;
+  case SLASH:         op = OP_DIVIDE; break;
+  default:            op = OP_ADD; break;
+  }
+  mark(expr.getOp());
+  emit(op, -1);
+  return Value();
+}
+
+Value Compiler::visitGroupingExpr(Grouping& expr)
+{
+  compile(expr.getExpr());
+  return Value();
+}
+
+Value Compiler::visitLiteralExpr(Literal& expr)
+{
+  const Value& lit = expr.getLit();
+  if (lit.isNil())
+    emit(OP_NIL, 1);
+  else if (lit.isBool())
+    emit(lit.asBool() ? OP_TRUE : OP_FALSE, 1);
+  else
+    emit(OP_CONSTANT, addConstant(lit), 1);
+  return Value();
+}
+
+Value Compiler::visitUnaryExpr(Unary& expr)
+{
+  compile(expr.getRight());
+  if (expr.getOp().type == BANG)
+  {
+    emit(OP_NOT, 0);
+    return Value();
+  }
+  mark(expr.getOp());
+  emit(OP_NEGATE, 0);
+  return Value();
+}
+
+Value Compiler::visitVariableExpr(Variable& expr)
+{
+  const VarRef& ref = expr.getRef();
+  switch (ref.kind)
+  {
+  case VAR_LOCAL:   emit(OP_GET_LOCAL, ref.index, 1); break;
+  case VAR_CELL:    emit(OP_GET_CELL, ref.index, 1); break;
+  case VAR_UPVALUE: emit(OP_GET_UPVALUE, ref.index, 1); break;
+  default:
+    mark(expr.getName());
+    emit(OP_GET_GLOBAL, ref.index, 1);
+    break;
+  }
+  return Value();
+}
+
+Value Compiler::visitAssignExpr(Assign& expr)
+{
+  compile(expr.getValue());
+  const VarRef& ref = expr.getRef();
+  switch (ref.kind)
+  {
+  case VAR_LOCAL:   emit(OP_SET_LOCAL, ref.index, 0); break;
+  case VAR_CELL:    emit(OP_SET_CELL, ref.index, 0); break;
+  case VAR_UPVALUE: emit(OP_SET_UPVALUE, ref.index, 0); break;
+  default:
+    mark(expr.getName());
+    emit(OP_SET_GLOBAL, ref.index, 0);
+    break;
+  }
+  return Value();
+}
+
+Value Compiler::visitLambdaExpr(Lambda& expr)
+{
+  compileFunction(expr.getInfo());
+  chunk->functions.push_back({ &expr.getInfo(), nullptr });
+  emit(OP_CLOSURE, chunk->functions.size() - 1, 1);
+  return Value();
+}
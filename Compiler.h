@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Stmt.h"
+#include "Chunk.h"
+#include <list>
+#include <unordered_map>
+
+/*
+ * Turns a resolved program into bytecode for the VM. Runs after the
+ * Resolver, which already decided where every variable lives, so this
+ * is a straight walk over the AST. Every function body gets its own
+ * Chunk (FunctionInfo::chunk), all of them owned by chunks.
+ */
+class Compiler : public ExprVisitor<Value>, public StmtVisitor<Completion>
+{
+public:
+	Compiler(std::vector<std::unique_ptr<Chunk>>& chunks) : chunks(chunks) {}
+
+	/* the top-level code, throws a token/message pair like the interpreter */
+	Chunk* compile(const std::list<std::unique_ptr<Stmt>>& statements);
+private:
+	struct Loop
+	{
+		Loop* enclosing;
+		int start;
+		/* jumps to patch when the loop is done */
+		std::vector<int> breaks;
+	};
+
+	Chunk* newChunk();
+	void compileFunction(FunctionInfo& info);
+	void compile(const std::vector<std::unique_ptr<Stmt>>& statements);
+	void compile(Stmt& stmt);
+	void compile(Expr& expr);
+	void emit(OpCode op, int stackEffect);
+	void emit(OpCode op, int operand, int stackEffect);
+	int emitJump(OpCode op, int stackEffect);
+	void patchJump(int offset);
+	void emitLoop(int start);
+	void mark(const Token& token);
+	void define(const VarDecl& decl);
+	int addConstant(const Value& value);
+	void tooBig(const char* msg);
+
+	Completion visitReturnStmt(Return& stmt) override;
+	Completion visitFunctionStmt(Function& stmt) override;
+	Completion visitBreakStmt(Break& stmt) override;
+	Completion visitContinueStmt(Continue& stmt) override;
+	Completion visitWhileStmt(While& stmt) override;
+	Completion visitIfStmt(If& stmt) override;
+	Completion visitExpressionStmt(Expression& stmt) override;
+	Completion visitPrintStmt(Print& stmt) override;
+	Completion visitVarStmt(Var& stmt) override;
+	Completion visitBlockStmt(Block& stmt) override;
+	Value visitCallExpr(Call& expr) override;
+	Value visitLogicalExpr(Logical& expr) override;
+	Value visitBinaryExpr(Binary& expr) override;
+	Value visitGroupingExpr(Grouping& expr) override;
+	Value visitLiteralExpr(Literal& expr) override;
+	Value visitUnaryExpr(Unary& expr) override;
+	Value visitVariableExpr(Variable& expr) override;
+	Value visitAssignExpr(Assign& expr) override;
+	Value visitLambdaExpr(Lambda& expr) override;
+private:
+	std::vector<std::unique_ptr<Chunk>>& chunks;
+	Chunk* chunk = nullptr;
+	Loop* loop = nullptr;
+	/* values on the stack at this point of the chunk, to work out maxStack */
+	int depth = 0;
+	/* the chunk's number constants by their bits, a number goes in once */
+	std::unordered_map<uint64_t, int> numbers;
+	/* last token seen, for the rare compile error */
+	const Token* token = nullptr;
+};
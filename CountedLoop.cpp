@@ -0,0 +1,181 @@
+#include "CountedLoop.h"
+
+/* collects what a loop body does to variables, nested functions included */
+class LoopScan : public ExprVisitor<Value>, public StmtVisitor<Completion>
+{
+public:
+  LoopScan(const VarRef& counter, const VarRef* bound) : counter(counter), bound(bound) {}
+
+  void scan(Stmt& stmt)
+  {
+    stmt.accept(*this);
+  }
+
+  void scan(Expr& expr)
+  {
+    expr.accept(*this);
+  }
+
+  void scan(const std::vector<std::unique_ptr<Stmt>>& statements)
+  {
+    for (const auto& statement : statements)
+    {
+      if (statement != nullptr)
+        scan(*statement);
+    }
+  }
+
+  bool hasCall = false;
+  bool assigns = false;
+private:
+  static bool same(const VarRef& a, const VarRef& b)
+  {
+    return a.kind == b.kind && a.index == b.index;
+  }
+
+  Completion visitReturnStmt(Return& stmt) override { scan(stmt.getValue()); return Completion(); }
+  Completion visitFunctionStmt(Function& stmt) override { scan(stmt.getInfo().getBody()); return Completion(); }
+  Completion visitBreakStmt(Break& stmt) override { return Completion(); }
+  Completion visitContinueStmt(Continue& stmt) override { return Completion(); }
+  Completion visitExpressionStmt(Expression& stmt) override { scan(stmt.getExpr()); return Completion(); }
+  Completion visitPrintStmt(Print& stmt) override { scan(stmt.getExpr()); return Completion(); }
+  Completion visitBlockStmt(Block& stmt) override { scan(stmt.getStatements()); return Completion(); }
+
+  Completion visitWhileStmt(While& stmt) override
+  {
+    scan(stmt.getCondition());
+    scan(stmt.getBody());
+    return Completion();
+  }
+
+  Completion visitIfStmt(If& stmt) override
+  {
+    scan(stmt.getCondition());
+    scan(stmt.getThen());
+    if (stmt.hasElse())
+      scan(stmt.getElse());
+    return Completion();
+  }
+
+  Completion visitVarStmt(Var& stmt) override
+  {
+    if (stmt.hasInitializer())
+      scan(stmt.getInitializer());
+    return Completion();
+  }
+
+  Value visitCallExpr(Call& expr) override
+  {
+    hasCall = true;
+    scan(expr.getCallee());
+    for (const auto& arg : expr.getArgs())
+      scan(*arg);
+    return Value();
+  }
+
+  Value visitLogicalExpr(Logical& expr) override
+  {
+    scan(expr.getLeft());
+    scan(expr.getRight());
+    return Value();
+  }
+
+  Value visitBinaryExpr(Binary& expr) override
+  {
+    scan(expr.getLeft());
+    scan(expr.getRight());
+    return Value();
+  }
+
+  Value visitGroupingExpr(Grouping& expr) override { scan(expr.getExpr()); return Value(); }
+  Value visitLiteralExpr(Literal& expr) override { return Value(); }
+  Value visitUnaryExpr(Unary& expr) override { scan(expr.getRight()); return Value(); }
+  Value visitVariableExpr(Variable& expr) override { return Value(); }
+
+  /* slots in a nested function's frame can match too, that only makes this more careful */
+  Value visitAssignExpr(Assign& expr) override
+  {
+    if (same(expr.getRef(), counter) || (bound != nullptr && same(expr.getRef(), *bound)))
+      assigns = true;
+    scan(expr.getValue());
+    return Value();
+  }
+
+  Value visitLambdaExpr(Lambda& expr) override
+  {
+    scan(expr.getBody());
+    return Value();
+  }
+
+  const VarRef& counter;
+  const VarRef* bound;
+};
+
+/* a local the Resolver didn't have to box, or a global */
+static bool isPlainVariable(Expr& expr)
+{
+  Variable* variable = dynamic_cast<Variable*>(&expr);
+  return variable != nullptr && (variable->getRef().kind == VAR_LOCAL || variable->getRef().kind == VAR_GLOBAL);
+}
+
+bool analyzeCountedLoop(While& stmt, CountedLoop& loop)
+{
+  /* i < bound */
+  Binary* condition = dynamic_cast<Binary*>(&stmt.getCondition());
+  if (condition == nullptr || !isPlainVariable(condition->getLeft()))
+    return false;
+  TokenType op = condition->getOp().type;
+  if (op != LESS && op != LESS_EQUAL && op != GREATER && op != GREATER_EQUAL)
+    return false;
+  const VarRef& counter = static_cast<Variable&>(condition->getLeft()).getRef();
+
+  const VarRef* bound = nullptr;
+  if (Literal* literal = dynamic_cast<Literal*>(&condition->getRight()))
+  {
+    if (!literal->getLit().isNumber())
+      return false;
+    loop.boundIsLiteral = true;
+    loop.boundValue = literal->getLit().asNumber();
+  }
+  else if (isPlainVariable(condition->getRight()))
+  {
+    bound = &static_cast<Variable&>(condition->getRight()).getRef();
+    loop.boundIsLiteral = false;
+    loop.boundVar = *bound;
+  }
+  else
+    return false;
+
+  /* { ...; i = i + step; } */
+  Block* body = dynamic_cast<Block*>(&stmt.getBody());
+  if (body == nullptr || body->getStatements().empty() || body->getStatements().back() == nullptr)
+    return false;
+  Expression* last = dynamic_cast<Expression*>(body->getStatements().back().get());
+  Assign* increment = last != nullptr ? dynamic_cast<Assign*>(&last->getExpr()) : nullptr;
+  if (increment == nullptr || increment->getRef().kind != counter.kind || increment->getRef().index != counter.index)
+    return false;
+  Binary* step = dynamic_cast<Binary*>(&increment->getValue());
+  if (step == nullptr || (step->getOp().type != PLUS && step->getOp().type != MINUS))
+    return false;
+  Variable* stepVariable = dynamic_cast<Variable*>(&step->getLeft());
+  Literal* stepLiteral = dynamic_cast<Literal*>(&step->getRight());
+  if (stepVariable == nullptr || stepVariable->getRef().kind != counter.kind ||
+      stepVariable->getRef().index != counter.index || stepLiteral == nullptr || !stepLiteral->getLit().isNumber())
+    return false;
+
+  LoopScan scan(counter, bound);
+  const auto& statements = body->getStatements();
+  for (size_t i = 0; i + 1 < statements.size(); i++)
+  {
+    if (statements[i] != nullptr)
+      scan.scan(*statements[i]);
+  }
+  bool global = counter.kind == VAR_GLOBAL || (bound != nullptr && bound->kind == VAR_GLOBAL);
+  if (scan.assigns || (global && scan.hasCall))
+    return false;
+
+  loop.op = op;
+  loop.counter = counter;
+  loop.step = step->getOp().type == PLUS ? stepLiteral->getLit().asNumber() : -stepLiteral->getLit().asNumber();
+  return true;
+}
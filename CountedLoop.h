@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Stmt.h"
+
+/*
+ * Fills in loop and returns true if stmt is a counted loop, see
+ * CountedLoop in Stmt.h. Needs the Resolver's final VarRefs, a local
+ * only stays VAR_LOCAL if no closure captures it, so it runs on the
+ * loop's first run instead of while resolving.
+ *
+ * i and bound are locals or globals. Only the last statement of the
+ * body may assign i and nothing may assign bound. Code outside the loop
+ * can only get at them if they're globals, so then the body can't make
+ * any calls either.
+ */
+bool analyzeCountedLoop(While& stmt, CountedLoop& loop);
@@ -0,0 +1,115 @@
+#include "Engine.h"
+#include "Callable.h"
+#include <iostream>
+#include <utility>
+
+/* print goes here unless LScript.cpp says otherwise */
+static StdoutSink stdoutSink(FLUSH_LINE);
+
+Engine::Engine()
+  : output(&stdoutSink)
+{}
+
+void Engine::setOutput(OutputSink* sink)
+{
+  output = sink;
+}
+
+OutputSink& Engine::getOutput()
+{
+  return *output;
+}
+
+Environment& Engine::getGlobals()
+{
+  return globals;
+}
+
+void Engine::reportError(const Token& token, const std::string& msg)
+{
+  output->flush();
+  if (token.type == _EOF_)
+    std::cerr << "INTERPRETER ERROR: [" << token.line << "] at end: " << msg << std::endl;
+  else
+    std::cerr << "INTERPRETER ERROR: [" << token.line << "] at '" << token.lexeme << "': " << msg << std::endl;
+}
+
+void Engine::reportError(const std::string& msg)
+{
+  output->flush();
+  std::cerr << "INTERPRETER ERROR: " << msg << std::endl;
+}
+
+std::string memoryLimitMessage(size_t limit)
+{
+  return "Memory limit of " + std::to_string(limit) + " bytes exceeded.";
+}
+
+bool isEqual(const Value& a, const Value& b)
+{
+  if (a.getType() != b.getType())
+    return false;
+
+  switch (a.getType())
+  {
+  case VAL_NIL:    return true;
+  case VAL_BOOL:   return a.asBool() == b.asBool();
+  case VAL_NUMBER: return a.asNumber() == b.asNumber();
+  case VAL_STRING:
+    /* different lengths can't be equal, no need to flatten the ropes */
+    return a.asString()->getLength() == b.asString()->getLength() &&
+           a.asString()->getChars() == b.asString()->getChars();
+  default:         return a.asObject() == b.asObject();
+  }
+}
+
+static std::string stringify(const Value& value)
+{
+  switch (value.getType())
+  {
+  case VAL_NIL:      return "nil";
+  case VAL_BOOL:     return value.asBool() ? "true" : "false";
+  case VAL_NUMBER:   return numberToString(value.asNumber());
+  case VAL_STRING:   return value.asString()->getChars();
+  case VAL_CALLABLE: return value.asCallable()->toString();
+  }
+  return "";
+}
+
+void Engine::print(const Value& value)
+{
+  if (value.isNumber())
+    output->writeNumber(value.asNumber());
+  else if (value.isString())
+    output->write(value.asString()->getChars());
+  else
+    output->write(stringify(value));
+  output->endLine();
+}
+
+Value addValues(const Token& op, const Value& left, const Value& right)
+{
+  if (left.isNumber() && right.isNumber())
+    return left.asNumber() + right.asNumber();
+  /* the one place scripts make strings, so the error can say where */
+  try
+  {
+    if (left.isString() && right.isString())
+      return Value(String::concat(left.asString(), right.asString()));
+    if (left.isString() && right.isNumber())
+    {
+      Value number = Value(new String(numberToString(right.asNumber())));
+      return Value(String::concat(left.asString(), number.asString()));
+    }
+    if (left.isNumber() && right.isString())
+    {
+      Value number = Value(new String(numberToString(left.asNumber())));
+      return Value(String::concat(number.asString(), right.asString()));
+    }
+  }
+  catch (MemoryLimitError& error)
+  {
+    throw std::make_pair(op, memoryLimitMessage(error.limit));
+  }
+  throw std::make_pair(op, std::string("Operands must be FUCKING NUMBERS or FUCKING STRINGS"));
+}
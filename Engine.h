@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Stmt.h"
+#include "Environment.h"
+#include "Output.h"
+#include "Program.h"
+#include <list>
+
+/*
+ * Something that runs resolved programs, picked with --engine in
+ * LScript.cpp. Every engine runs the same AST with the same slots from
+ * the Resolver, so globals, output and the way runtime errors are
+ * reported live here.
+ */
+class Engine
+{
+public:
+	Engine();
+	virtual ~Engine() = default;
+	virtual void interpret(std::unique_ptr<Program> program, int slotCount) = 0;
+	void setOutput(OutputSink* sink);
+	OutputSink& getOutput();
+	Environment& getGlobals();
+
+	/* slots on the frame stack, a frame is params + locals of one call */
+	static constexpr int STACK_SIZE = 64 * 1024;
+	/* how deep calls can nest before it's a stack overflow */
+	static constexpr int MAX_CALL_DEPTH = 2000;
+protected:
+	void print(const Value& value);
+	/* flushes what the script printed first so the error shows up after it */
+	void reportError(const Token& token, const std::string& msg);
+	/* for errors with no token, going over --mem-limit outside of + */
+	void reportError(const std::string& msg);
+protected:
+	/*
+	 * functions point into the AST, so every program run stays alive (the
+	 * REPL). declared first so it also outlives the closures in globals
+	 */
+	std::vector<std::unique_ptr<Program>> programs;
+	Environment globals;
+	OutputSink* output;
+};
+
+bool isEqual(const Value& a, const Value& b);
+
+inline bool isTruthy(const Value& anythang)
+{
+	if (anythang.isNil())
+		return false;
+	if (anythang.isBool())
+		return anythang.asBool();
+	return true;
+}
+
+std::string memoryLimitMessage(size_t limit);
+
+/* what a call to info counts for in Memory while it runs, the same on every engine */
+inline size_t frameBytes(const FunctionInfo& info)
+{
+	return info.slotCount * sizeof(Value);
+}
+
+/* + when at least one side isn't a number */
+Value addValues(const Token& op, const Value& left, const Value& right);
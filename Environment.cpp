@@ -1,36 +1,19 @@
 #include "Environment.h"
-#include "Callable.h"
-#include <iostream>
 
-std::any Environment::get(const Token& name)
+int Environment::slotFor(Symbol name)
 {
-  if (values.find(name.lexeme) != values.end())
-    return values.find(name.lexeme)->second;
+  if (name >= slots.size())
+    slots.resize(name + 1, -1);
+  if (slots[name] >= 0)
+    return slots[name];
 
-  if (enclosing != nullptr)
-    return enclosing->get(name);
-
-  throw (std::make_pair(name, "Undefined variable: " + name.lexeme));
-}
-
-void Environment::define(std::string name, std::any value)
-{
-  values[name] = value;
+  int slot = values.size();
+  slots[name] = slot;
+  values.push_back(Value::undefined());
+  return slot;
 }
 
-void Environment::assign(const Token& name, std::any value)
+void Environment::undefined(const Token& name)
 {
-  if (values.find(name.lexeme) != values.end())
-  {
-    values[name.lexeme] = value;
-    return;
-  }
-
-  if (enclosing != nullptr)
-  {
-    enclosing->assign(name, value);
-    return;
-  }
-
-  throw (std::make_pair(name, "Undefined variable: " + name.lexeme));
+  throw (std::make_pair(name, "Undefined variable: " + std::string(name.lexeme)));
 }
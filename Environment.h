@@ -1,17 +1,53 @@
 #pragma once
 
-#include <map>
+#include <string>
+#include <vector>
 #include "Token.h"
+#include "Value.h"
 
+/*
+ * The global variables, in a dense array. The Resolver hands out a slot
+ * per global name (slotFor) and annotates the code with it, so at
+ * runtime a global is a single indexed load. The names are Symbols, so
+ * resolving one is an indexed load too.
+ *
+ * A slot that was handed out but whose var/function hasn't run yet
+ * holds an undefined Value, reading or assigning it is an error.
+ */
 class Environment
 {
 public:
-  Environment() : enclosing(nullptr) {}
-  Environment(Environment *enclosing) : enclosing(enclosing) {}
-  std::any get(const Token& name);
-  void define(std::string name, std::any value);
-  void assign(const Token& name, std::any value);
+  int slotFor(Symbol name);
+
+  const Value& get(int slot, const Token& name)
+  {
+    const Value& value = values[slot];
+    if (value.isUndefined())
+      undefined(name);
+    return value;
+  }
+
+  void define(int slot, Value value)
+  {
+    values[slot] = std::move(value);
+  }
+
+  void assign(int slot, const Token& name, Value value)
+  {
+    if (values[slot].isUndefined())
+      undefined(name);
+    values[slot] = std::move(value);
+  }
+
+  /* no check, for the VM which only looks up the token when it has to */
+  Value& at(int slot)
+  {
+    return values[slot];
+  }
+
+  [[noreturn]] void undefined(const Token& name);
 private:
-  Environment *enclosing;
-  std::map<std::string, std::any> values;
-};
\ No newline at end of file
+  /* by Symbol, -1 for names that aren't globals */
+  std::vector<int> slots;
+  std::vector<Value> values;
+};
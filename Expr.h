@@ -1,10 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
-#include <any>
+#include "Value.h"
 #include <string>
 #include <vector>
 #include "Token.h"
+#include "Arena.h"
 
 class Lambda;
 class Call;
@@ -15,6 +17,66 @@ class Literal;
 class Unary;
 class Variable;
 class Assign;
+class Optimizer;
+class FunctionInfo;
+
+enum VarKind
+{
+	VAR_GLOBAL,   /* slot in the global table */
+	VAR_LOCAL,    /* slot in the current frame */
+	VAR_CELL,     /* slot in the current frame holding a Cell, a closure captured it */
+	VAR_UPVALUE   /* index into the running closure's upvalues */
+};
+
+/* where a Variable/Assign finds its variable, filled in by the Resolver */
+struct VarRef
+{
+	VarKind kind = VAR_GLOBAL;
+	int index = -1;
+};
+
+/*
+ * inline cache of a call site: the function the last call made there
+ * went to. arity only depends on the function, so a call to the same
+ * one again doesn't have to check it
+ */
+struct CallCache
+{
+	FunctionInfo* info = nullptr;
+	/* whether the tree walker inlines calls to info here, see Inliner.h */
+	enum Inlining : uint8_t { INLINE_UNSEEN, INLINE_YES, INLINE_NO };
+	Inlining inlining = INLINE_UNSEEN;
+};
+
+/*
+ * What a Binary, Unary or Logical node specialized itself to in the tree
+ * walker, from the operand types of its first run. A specialized node
+ * checks for just those types, and goes back to generic for good the
+ * first time it sees others.
+ */
+enum Specialization : uint8_t
+{
+	SPEC_UNSEEN,
+	SPEC_GENERIC,
+	/* Binary on two numbers, one per operator */
+	SPEC_NUMBER_ADD,
+	SPEC_NUMBER_SUBTRACT,
+	SPEC_NUMBER_MULTIPLY,
+	SPEC_NUMBER_DIVIDE,
+	SPEC_NUMBER_GREATER,
+	SPEC_NUMBER_GREATER_EQUAL,
+	SPEC_NUMBER_LESS,
+	SPEC_NUMBER_LESS_EQUAL,
+	SPEC_NUMBER_EQUAL,
+	SPEC_NUMBER_NOT_EQUAL,
+	/* Binary + on two strings */
+	SPEC_STRING_CONCAT,
+	/* Unary - on a number, ! on a bool */
+	SPEC_NUMBER_NEGATE,
+	SPEC_BOOL_NOT,
+	/* Logical with a bool on the left */
+	SPEC_BOOL_LOGICAL
+};
 
 template <typename T>
 class ExprVisitor
@@ -31,20 +93,32 @@ public:
 	virtual T visitAssignExpr(Assign &expr) = 0;
 };
 
+/*
+ * AST nodes point at their tokens in the Program instead of copying
+ * them and are allocated in its Arena, see Program.h
+ */
 class Expr
 {
 public:
-	virtual std::any accept(ExprVisitor<std::any> &visitor) = 0;
+	virtual ~Expr() = default;
+	virtual Value accept(ExprVisitor<Value> &visitor) = 0;
+
+	static void* operator new(size_t size)
+	{
+		return Arena::allocateNode(size);
+	}
+
+	static void operator delete(void* ptr) {}
 };
 
 class Call : public Expr
 {
 public:
 	Call(std::unique_ptr<Expr> callee, const Token& paren, std::vector<std::unique_ptr<Expr>> args)
-		: callee(std::move(callee)), paren(paren), args(std::move(args))
+		: callee(std::move(callee)), paren(&paren), args(std::move(args))
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitCallExpr(*this);
 	}
@@ -56,7 +130,7 @@ public:
 
 	const Token& getParen()
 	{
-		return paren;
+		return *paren;
 	}
 
 	const std::vector<std::unique_ptr<Expr>>& getArgs()
@@ -64,20 +138,27 @@ public:
 		return args;
 	}
 
+	CallCache& getCache()
+	{
+		return cache;
+	}
+
 private:
+	friend class Optimizer;
 	std::unique_ptr<Expr> callee;
-	Token paren;
+	const Token* paren;
   std::vector<std::unique_ptr<Expr>> args;
+	CallCache cache;
 };
 
 class Logical : public Expr
 {
 public:
 	Logical(std::unique_ptr<Expr> left, const Token& op, std::unique_ptr<Expr> right)
-		: left(std::move(left)), op(op), right(std::move(right))
+		: left(std::move(left)), op(&op), right(std::move(right))
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitLogicalExpr(*this);
 	}
@@ -89,7 +170,7 @@ public:
 
 	const Token& getOp()
 	{
-		return op;
+		return *op;
 	}
 
 	Expr& getRight()
@@ -97,10 +178,17 @@ public:
 		return *right;
 	}
 
+	Specialization& getSpecialization()
+	{
+		return spec;
+	}
+
 private:
+	friend class Optimizer;
 	std::unique_ptr<Expr> left;
-	Token op;
+	const Token* op;
 	std::unique_ptr<Expr> right;
+	Specialization spec = SPEC_UNSEEN;
 };
 
 
@@ -108,10 +196,10 @@ class Binary : public Expr
 {
 public:
 	Binary(std::unique_ptr<Expr> left, const Token &op, std::unique_ptr<Expr> right)
-		: left(std::move(left)), op(op), right(std::move(right))
+		: left(std::move(left)), op(&op), right(std::move(right))
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitBinaryExpr(*this);
 	}
@@ -123,7 +211,7 @@ public:
 
 	const Token& getOp()
 	{
-		return op;
+		return *op;
 	}
 
 	Expr& getRight()
@@ -131,10 +219,17 @@ public:
 		return *right;
 	}
 
+	Specialization& getSpecialization()
+	{
+		return spec;
+	}
+
 private:
+	friend class Optimizer;
 	std::unique_ptr<Expr> left;
-	Token op;
+	const Token* op;
 	std::unique_ptr<Expr> right;
+	Specialization spec = SPEC_UNSEEN;
 };
 
 
@@ -145,7 +240,7 @@ public:
 		: expression(std::move(expression))
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitGroupingExpr(*this);
 	}
@@ -156,27 +251,28 @@ public:
 	}
 
 private:
+	friend class Optimizer;
 	std::unique_ptr<Expr> expression;
 };
 
 class Literal : public Expr
 {
 public:
-	Literal(std::any lit)
+	Literal(Value lit)
 		: lit(lit)
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitLiteralExpr(*this);
 	}
 
-	std::any getLit()
+	const Value& getLit()
 	{
 		return lit;
 	}
 private:
-	std::any lit;
+	Value lit;
 };
 
 
@@ -184,10 +280,10 @@ class Unary : public Expr
 {
 public:
 	Unary(const Token& op, std::unique_ptr<Expr> right)
-		: op(op), right(std::move(right))
+		: op(&op), right(std::move(right))
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitUnaryExpr(*this);
 	}
@@ -199,57 +295,77 @@ public:
 
 	const Token& getOp()
 	{
-		return op;
+		return *op;
+	}
+
+	Specialization& getSpecialization()
+	{
+		return spec;
 	}
 
 private:
-	Token op;
+	friend class Optimizer;
+	const Token* op;
 	std::unique_ptr<Expr> right;
+	Specialization spec = SPEC_UNSEEN;
 };
 
 class Variable : public Expr
 {
 public:
 	Variable(const Token& name)
-		: name(name)
+		: name(&name)
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitVariableExpr(*this);
 	}
 
 	const Token& getName()
 	{
-		return name;
+		return *name;
+	}
+
+	VarRef& getRef()
+	{
+		return ref;
 	}
 
 private:
-	Token name;
+	const Token* name;
+	VarRef ref;
 };
 
 class Assign : public Expr
 {
 public:
 	Assign(const Token& name, std::unique_ptr<Expr> value)
-		: name(name), value(std::move(value))
+		: name(&name), value(std::move(value))
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitAssignExpr(*this);
 	}
 
 	const Token& getName()
 	{
-		return name;
+		return *name;
 	}
 
 	Expr& getValue()
 	{
 		return *value;
 	}
+
+	VarRef& getRef()
+	{
+		return ref;
+	}
 private:
-	Token name;
+	friend class Optimizer;
+	const Token* name;
 	std::unique_ptr<Expr> value;
+	VarRef ref;
 };
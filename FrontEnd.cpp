@@ -0,0 +1,229 @@
+#include "FrontEnd.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Scan.h"
+#include "Stats.h"
+#include "Memory.h"
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+/* function or var as a whole word at p */
+static bool startsDeclaration(const char* p, const char* end)
+{
+  for (std::string_view keyword : { std::string_view("function"), std::string_view("var") })
+  {
+    if (size_t(end - p) > keyword.size() && std::string_view(p, keyword.size()) == keyword && !isIdentifierChar(p[keyword.size()]))
+      return true;
+  }
+  return false;
+}
+
+/*
+ * the quick pass: braces and parens to know what's top level, strings and
+ * comments skipped so what's in them doesn't count. stops cutting at the
+ * first one that doesn't end, the Lexer reports it
+ */
+template <typename Piece>
+static std::vector<Piece> split(std::string_view src, size_t count)
+{
+  std::vector<Piece> pieces{ { 0, 0 } };
+  const char* begin = src.data();
+  const char* end = begin + src.size();
+  const char* p = begin;
+  size_t target = src.size() / count;
+  int depth = 0;
+  int line = 0;
+  /* the last thing that wasn't whitespace or a comment */
+  char last = 0;
+  while (p < end && pieces.size() < count)
+  {
+    char c = *p;
+    if (isSpaceChar(c))
+    {
+      p = skipSpace(p, end, line);
+      continue;
+    }
+    if (c == '"')
+    {
+      p = findQuote(p + 1, end, line);
+      if (p == end)
+        break;
+      p++;
+      last = c;
+      continue;
+    }
+    if (c == '/' && p + 1 < end && p[1] == '/')
+    {
+      p = findNewline(p, end);
+      continue;
+    }
+    if (c == '/' && p + 1 < end && p[1] == '*')
+    {
+      p = findCommentEnd(p + 2, end, line);
+      if (p == end)
+        break;
+      p += 2;
+      continue;
+    }
+    if (isIdentifierChar(c))
+    {
+      if (depth == 0 && (last == '}' || last == ';') && size_t(p - begin) >= pieces.size() * target && startsDeclaration(p, end))
+        pieces.push_back({ size_t(p - begin), line });
+      p = skipIdentifier(p, end);
+      last = c;
+      continue;
+    }
+    if (c == '{' || c == '(')
+      depth++;
+    else if (c == '}' || c == ')')
+      depth--;
+    last = c;
+    p++;
+  }
+  return pieces;
+}
+
+/* what a worker thread counted in its own Stats and Memory, see Stats.h */
+struct WorkerCounts
+{
+  uint64_t allocations = 0;
+  uint64_t allocatedBytes = 0;
+  Memory memory;
+};
+
+/* runs work(i) for every i < count on up to threads threads, this one too */
+template <typename Work>
+static void parallelFor(size_t count, int threads, Work work)
+{
+  std::atomic<size_t> next{ 0 };
+  auto run = [&]()
+  {
+    for (size_t i = next++; i < count; i = next++)
+      work(i);
+  };
+
+  size_t workers = std::min<size_t>(threads, count) - 1;
+  std::vector<WorkerCounts> counts(workers);
+  std::vector<std::thread> pool;
+  for (size_t t = 0; t < workers; t++)
+  {
+    pool.emplace_back([&, t]()
+    {
+      run();
+      counts[t].allocations = stats.allocations;
+      counts[t].allocatedBytes = stats.allocatedBytes;
+      counts[t].memory.add(memory);
+    });
+  }
+  run();
+  for (std::thread& thread : pool)
+    thread.join();
+
+  for (const WorkerCounts& worker : counts)
+  {
+    stats.allocations += worker.allocations;
+    stats.allocatedBytes += worker.allocatedBytes;
+    memory.add(worker.memory);
+  }
+}
+
+static bool anyErrors(const std::vector<std::ostringstream>& errors)
+{
+  for (const std::ostringstream& error : errors)
+  {
+    if (!error.str().empty())
+      return true;
+  }
+  return false;
+}
+
+FrontEnd::FrontEnd(Program& program, int threads)
+  : program(program), threads(threads != 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency()))
+{
+  size_t count = std::min<size_t>((size_t)this->threads * PIECES_PER_THREAD, program.source.size() / MIN_PIECE);
+  if (this->threads > 1 && count > 1)
+    pieces = split<Piece>(program.source.view(), count);
+}
+
+void FrontEnd::lexSerial()
+{
+  Lexer lexer(program.source.view());
+  program.tokens.clear();
+  program.tokens.push_back(lexer.lexAll());
+  failed = lexer.hadErrors();
+}
+
+void FrontEnd::parseSerial()
+{
+  Parser parser(program.tokens.front());
+  program.statements = parser.parse();
+  failed = failed || parser.hadErrors();
+}
+
+void FrontEnd::lex()
+{
+  if (pieces.size() < 2)
+  {
+    lexSerial();
+    return;
+  }
+
+  std::string_view src = program.source.view();
+  std::vector<std::vector<Token>> tokens(pieces.size());
+  std::vector<std::ostringstream> errors(pieces.size());
+  parallelFor(pieces.size(), threads, [&](size_t i)
+  {
+    size_t end = i + 1 < pieces.size() ? pieces[i + 1].offset : src.size();
+    LocalSymbols symbols;
+    tokens[i] = Lexer(src.substr(pieces[i].offset, end - pieces[i].offset), pieces[i].line, &symbols, errors[i]).lexAll();
+    std::vector<Symbol> published = symbols.publish();
+    for (Token& token : tokens[i])
+    {
+      if (token.type == IDENTIFIER)
+        token.lit = published[token.symbol()];
+    }
+  });
+
+  serial = anyErrors(errors);
+  if (serial)
+    lexSerial();
+  else
+    program.tokens = std::move(tokens);
+}
+
+void FrontEnd::parse()
+{
+  if (pieces.size() < 2 || serial)
+  {
+    parseSerial();
+    return;
+  }
+
+  std::vector<std::unique_ptr<Arena>> arenas(pieces.size());
+  std::vector<std::list<std::unique_ptr<Stmt>>> statements(pieces.size());
+  std::vector<std::ostringstream> errors(pieces.size());
+  parallelFor(pieces.size(), threads, [&](size_t i)
+  {
+    arenas[i] = std::make_unique<Arena>();
+    Arena::Scope scope(*arenas[i]);
+    statements[i] = Parser(program.tokens[i], errors[i]).parse();
+  });
+
+  serial = anyErrors(errors);
+  if (serial)
+  {
+    /* the pieces' nodes go first, they point into their arenas and tokens */
+    statements.clear();
+    arenas.clear();
+    lexSerial();
+    parseSerial();
+    return;
+  }
+
+  for (size_t i = 0; i < pieces.size(); i++)
+  {
+    program.statements.splice(program.statements.end(), statements[i]);
+    Arena::current->adopt(*arenas[i]);
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Program.h"
+#include <memory>
+#include <vector>
+
+/*
+ * Lexes and parses a Program's source, on more than one thread for big
+ * scripts (--parse-threads). A quick pass over the source finds where it
+ * can be cut: right before a function or var at the top level, after the
+ * } or ; that ended the statement before it. Each piece is lexed on its
+ * own, starting from the line it's on, then parsed on its own into its
+ * own Arena. The pieces' statements go back together in source order and
+ * the Program takes over their tokens and Arenas.
+ *
+ * Any lexer or parser error in a piece and the whole source is done
+ * again on one thread, so errors come out exactly as they always did.
+ */
+class FrontEnd
+{
+public:
+	/* threads 0 for one per core */
+	FrontEnd(Program& program, int threads);
+	/* fills in program.tokens */
+	void lex();
+	/* fills in program.statements, nodes go in Arena::current */
+	void parse();
+	/* the lexer or the parser reported errors, see ProgramCache */
+	bool hadErrors() const
+	{
+		return failed;
+	}
+
+	/* pieces smaller than this aren't worth a thread */
+	static constexpr size_t MIN_PIECE = 64 * 1024;
+	/* more pieces than threads, so the threads finish at about the same time */
+	static constexpr int PIECES_PER_THREAD = 4;
+private:
+	void lexSerial();
+	void parseSerial();
+
+	/* where a piece starts in the source and the line it starts on */
+	struct Piece
+	{
+		size_t offset;
+		int line;
+	};
+
+	Program& program;
+	int threads;
+	std::vector<Piece> pieces;
+	/* a piece had errors, the whole source went through on one thread */
+	bool serial = false;
+	bool failed = false;
+};
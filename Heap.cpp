@@ -0,0 +1,125 @@
+#include "Heap.h"
+#include "Callable.h"
+#include "Stats.h"
+#include <algorithm>
+
+/* never destroyed, engines and the AST still release objects while statics go away */
+Heap& heap = *new Heap();
+
+void trackObject(Object* object)
+{
+  heap.track(object);
+}
+
+void Heap::track(Object* object)
+{
+  object->heapIndex = objects.size();
+  objects.push_back(object);
+  if (stress || objects.size() >= threshold)
+    collect();
+}
+
+void Heap::untrack(Object* object)
+{
+  Object* last = objects.back();
+  objects[object->heapIndex] = last;
+  last->heapIndex = object->heapIndex;
+  objects.pop_back();
+}
+
+void Heap::setLimits(size_t threshold, size_t growth)
+{
+  this->minThreshold = this->threshold = threshold;
+  this->growth = growth;
+}
+
+void Heap::setStress(bool stress)
+{
+  this->stress = stress;
+}
+
+/* the closures and cells object points at */
+void Heap::children(Object* object, std::vector<Object*>& out)
+{
+  if (object->type == VAL_CELL)
+  {
+    const Value& value = static_cast<Cell*>(object)->value;
+    if (value.isCallable() || value.isCell())
+      out.push_back(value.asObject());
+    return;
+  }
+  for (const Value& upvalue : static_cast<Callable*>(object)->getUpvalues())
+    out.push_back(upvalue.asObject());
+}
+
+void Heap::collect()
+{
+  if (collecting)
+    return;
+  collecting = true;
+  stats.gcCollections++;
+
+  /* references from inside the heap, a new object nobody holds yet (0 refs) is a root too */
+  std::vector<uint32_t> internal(objects.size(), 0);
+  std::vector<Object*> edges;
+  for (Object* object : objects)
+    children(object, edges);
+  for (Object* child : edges)
+    internal[child->heapIndex]++;
+
+  std::vector<bool> marked(objects.size(), false);
+  std::vector<Object*> work;
+  for (Object* object : objects)
+  {
+    if (object->refs == 0 || object->refs > internal[object->heapIndex])
+    {
+      marked[object->heapIndex] = true;
+      work.push_back(object);
+    }
+  }
+  while (!work.empty())
+  {
+    Object* object = work.back();
+    work.pop_back();
+    edges.clear();
+    children(object, edges);
+    for (Object* child : edges)
+    {
+      if (!marked[child->heapIndex])
+      {
+        marked[child->heapIndex] = true;
+        work.push_back(child);
+      }
+    }
+  }
+
+  std::vector<Object*> garbage;
+  for (Object* object : objects)
+  {
+    if (!marked[object->heapIndex])
+      garbage.push_back(object);
+  }
+
+  /*
+   * hold on to all of them while the references between them are
+   * cleared, so none is freed halfway, then let go and they all are
+   */
+  for (Object* object : garbage)
+    object->refs++;
+  for (Object* object : garbage)
+  {
+    if (object->type == VAL_CELL)
+      static_cast<Cell*>(object)->value = Value();
+    else
+      static_cast<Callable*>(object)->getUpvalues().clear();
+  }
+  for (Object* object : garbage)
+  {
+    if (--object->refs == 0)
+      freeObject(object);
+  }
+  stats.gcFreed += garbage.size();
+
+  threshold = std::max(minThreshold, objects.size() * growth / 100);
+  collecting = false;
+}
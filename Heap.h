@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Value.h"
+#include <cstdint>
+#include <vector>
+
+/*
+ * Keeps every closure and cell, the objects that can end up in a cycle
+ * (a local function that calls itself captures the cell it's stored in,
+ * so do closures stored in a variable they capture), and collects the
+ * cycles reference counting can't free. Strings can't point back at
+ * anything, counting alone frees them.
+ *
+ * A collection is mark-sweep. The roots are the objects something
+ * outside the Heap still points at: the engines' frame stacks, the
+ * globals, the AST and VM constants, and Values in C++ locals. Those are
+ * found without having to list them by subtracting the references
+ * closures and cells hold on each other from each object's refcount.
+ * Whatever can't be reached from an object with references left over
+ * is garbage, it gets its references cleared and is freed.
+ *
+ * Runs when the number of tracked objects hits a threshold, which then
+ * grows to growth percent of what survived (--gc-threshold, --gc-growth),
+ * or on every closure and cell made with --gc-stress.
+ */
+class Heap
+{
+public:
+  void track(Object* object);
+  void untrack(Object* object);
+  void collect();
+  void setLimits(size_t threshold, size_t growth);
+  void setStress(bool stress);
+
+  size_t getTracked() const
+  {
+    return objects.size();
+  }
+
+  static constexpr size_t DEFAULT_THRESHOLD = 16 * 1024;
+  static constexpr size_t DEFAULT_GROWTH = 200;
+private:
+  void children(Object* object, std::vector<Object*>& out);
+
+  std::vector<Object*> objects;
+  size_t minThreshold = DEFAULT_THRESHOLD;
+  size_t threshold = DEFAULT_THRESHOLD;
+  size_t growth = DEFAULT_GROWTH;
+  bool stress = false;
+  bool collecting = false;
+};
+
+extern Heap& heap;
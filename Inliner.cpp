@@ -0,0 +1,100 @@
+#include "Inliner.h"
+#include <algorithm>
+
+/* counts the nodes of a body and looks for what can't be inlined */
+class InlineScan : public ExprVisitor<Value>, public StmtVisitor<Completion>
+{
+public:
+
+  void scan(Stmt& stmt)
+  {
+    nodes++;
+    stmt.accept(*this);
+  }
+
+  void scan(Expr& expr)
+  {
+    nodes++;
+    expr.accept(*this);
+  }
+
+  int nodes = 0;
+  bool inlinable = true;
+  std::vector<int> calls;
+private:
+  /* only the body's top-level statement gets scanned, which is never one of these */
+  Completion visitFunctionStmt(Function& stmt) override { inlinable = false; return Completion(); }
+  Completion visitBreakStmt(Break& stmt) override { inlinable = false; return Completion(); }
+  Completion visitContinueStmt(Continue& stmt) override { inlinable = false; return Completion(); }
+  Completion visitWhileStmt(While& stmt) override { inlinable = false; return Completion(); }
+  Completion visitIfStmt(If& stmt) override { inlinable = false; return Completion(); }
+  Completion visitVarStmt(Var& stmt) override { inlinable = false; return Completion(); }
+  Completion visitBlockStmt(Block& stmt) override { inlinable = false; return Completion(); }
+
+  Completion visitReturnStmt(Return& stmt) override
+  {
+    /* inlined it would be a nested call, a real call keeps it a tail call */
+    if (stmt.isTailCall())
+      inlinable = false;
+    scan(stmt.getValue());
+    return Completion();
+  }
+  Completion visitExpressionStmt(Expression& stmt) override { scan(stmt.getExpr()); return Completion(); }
+  Completion visitPrintStmt(Print& stmt) override { scan(stmt.getExpr()); return Completion(); }
+
+  Value visitCallExpr(Call& expr) override
+  {
+    Variable* callee = dynamic_cast<Variable*>(&expr.getCallee());
+    if (callee != nullptr && callee->getRef().kind == VAR_GLOBAL)
+      calls.push_back(callee->getRef().index);
+    scan(expr.getCallee());
+    for (const auto& arg : expr.getArgs())
+      scan(*arg);
+    return Value();
+  }
+
+  Value visitLogicalExpr(Logical& expr) override
+  {
+    scan(expr.getLeft());
+    scan(expr.getRight());
+    return Value();
+  }
+
+  Value visitBinaryExpr(Binary& expr) override
+  {
+    scan(expr.getLeft());
+    scan(expr.getRight());
+    return Value();
+  }
+
+  Value visitGroupingExpr(Grouping& expr) override { scan(expr.getExpr()); return Value(); }
+  Value visitLiteralExpr(Literal& expr) override { return Value(); }
+  Value visitUnaryExpr(Unary& expr) override { scan(expr.getRight()); return Value(); }
+  Value visitVariableExpr(Variable& expr) override { return Value(); }
+  Value visitAssignExpr(Assign& expr) override { scan(expr.getValue()); return Value(); }
+  /* would capture the frame, which only lives as long as the call */
+  Value visitLambdaExpr(Lambda& expr) override { inlinable = false; return Value(); }
+};
+
+bool canInline(FunctionInfo& info, int slot, int maxSize)
+{
+  InlineInfo& inlining = info.inlining;
+  if (!inlining.tried)
+  {
+    inlining.tried = true;
+    const auto& body = info.getBody();
+    if (body.size() != 1 || body[0] == nullptr || !info.captures.empty() || !info.boxedParams.empty())
+      return false;
+
+    InlineScan scan;
+    scan.scan(*body[0]);
+    if (!scan.inlinable || scan.nodes > maxSize)
+      return false;
+    inlining.body = body[0].get();
+    if (Return* ret = dynamic_cast<Return*>(inlining.body))
+      inlining.value = &ret->getValue();
+    inlining.calls = std::move(scan.calls);
+  }
+  /* the same function can be in several globals, recursion depends on the one this call site goes through */
+  return inlining.body != nullptr && std::find(inlining.calls.begin(), inlining.calls.end(), slot) == inlining.calls.end();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Stmt.h"
+
+/*
+ * Inlining for the tree walker. A call site whose callee is a global
+ * variable holding a function with a single small statement for a body
+ * (a return, a print or an expression) runs that statement right there
+ * instead of going through Callable::call and executeFunction. The args
+ * still become the frame, so the body runs unchanged.
+ *
+ * The CallCache is the guard: the call site only inlines the function
+ * it last went to, a global rebound to something else is a cache miss
+ * and gets looked at again, and a real call if that one doesn't qualify.
+ *
+ * A body that makes a closure, returns a tail call or is over maxSize
+ * nodes is never inlined. Functions that capture anything aren't
+ * either, the inlined body runs without its closure. A call site that
+ * goes through a global the body calls (recursion) doesn't inline it. How deep inlined bodies nest inside each other is limited by
+ * the Interpreter (--inline-depth).
+ */
+bool canInline(FunctionInfo& info, int slot, int maxSize);
@@ -1,78 +1,68 @@
 #include "Interpreter.h"
 #include "Callable.h"
+#include "CountedLoop.h"
+#include "Inliner.h"
+#include "Stats.h"
+#include <cmath>
 #include <iostream>
 #include <utility>
 
 #define checkNumbers(oprtor, l, r, oprand) \
 checkNumberOperands(oprtor, l, r); \
-return std::any_cast<double>(l) oprand std::any_cast<double>(r) \
+return l.asNumber() oprand r.asNumber() \
 
-static void error(Token token, std::string msg)
+static void checkNumberOperand(const Token& op, const Value& operand)
 {
-  if (token.type == _EOF_)
-    std::cerr << "INTERPRETER ERROR: [" << token.line << "] at end: " << msg << std::endl;
-  else
-    std::cerr << "INTERPRETER ERROR: [" << token.line << "] at '" << token.lexeme << "': " << msg << std::endl;
+  if (operand.isNumber())
+    return;
+  throw std::make_pair(op, std::string("Operand must be a number."));
 }
 
-bool isEqual(std::any a, std::any b)
+static void checkNumberOperands(const Token& op, const Value& left, const Value& right)
 {
-  if (a.type() == typeid(void) &&
-      b.type() == typeid(void))
-    return true;
-  if (a.type() == typeid(void))
-    return false;
-
-  if (a.type() == typeid(bool))
-    return (std::any_cast<bool>(a) == std::any_cast<bool>(b));
-  if (a.type() == typeid(double))
-    return (std::any_cast<double>(a) == std::any_cast<double>(b));
-  if (a.type() == typeid(std::string))
-    return (std::any_cast<std::string>(a) == std::any_cast<std::string>(b));
-
-  return false;
+  if (left.isNumber() && right.isNumber())
+    return;
+  throw std::make_pair(op, std::string("Operands must be numbers."));
 }
 
-static bool isTruthy(std::any anythang)
+Interpreter::Interpreter()
+  : stack(STACK_SIZE), jit(globals), jitMode(Jit::isSupported() ? JIT_ON : JIT_OFF)
 {
-  if (anythang.type() == typeid(void))
-    return false;
-  if (anythang.type() == typeid(bool))
-    return std::any_cast<bool>(anythang);
-  return true;
+  stackTop = stack.data();
 }
 
-static void checkNumberOperand(const Token& op, std::any operand)
+void Interpreter::setJitMode(JitMode mode)
 {
-  if (operand.type() == typeid(double))
-    return;
-  throw std::make_pair(op, std::string("Operand must be a number."));
+  jitMode = Jit::isSupported() ? mode : JIT_OFF;
 }
 
-static void checkNumberOperands(const Token& op, std::any left, std::any right)
+void Interpreter::setInlineLimits(int maxSize, int maxDepth)
 {
-  if (left.type() == typeid(double) &&
-      right.type() == typeid(double))
-    return;
-  throw std::make_pair(op, std::string("Operands must be numbers."));
+  inlineSize = maxSize;
+  inlineDepth = maxDepth;
 }
 
-static std::string stringify(std::any value)
+/* captured locals are boxed, but a slot whose declaration never ran isn't */
+static Value& cellValue(Value& slot)
 {
-  if (value.type() == typeid(bool))
-    return std::any_cast<bool>(value) ? "true" : "false";
-  if (value.type() == typeid(void))
-    return "nil";
-  if (value.type() == typeid(double))
-    return std::to_string(std::any_cast<double>(value));
-  return std::any_cast<std::string>(value);
+  return slot.isCell() ? slot.asCell()->value : slot;
 }
 
-void Interpreter::interpret(std::list<std::unique_ptr<Stmt>> statements)
+void Interpreter::interpret(std::unique_ptr<Program> program, int slotCount)
 {
+  programs.push_back(std::move(program));
+  /* locals of top-level blocks */
+  Value* scriptFrame = stack.data();
+  stackTop = scriptFrame + slotCount;
+  frame = scriptFrame;
+  function = nullptr;
+  callDepth = 0;
+  inlineNesting = 0;
+  uint64_t allocations = stats.allocations;
+  memory.beginRun();
   try
   {
-    for (auto& statement : statements)
+    for (auto& statement : programs.back()->statements)
     {
       execute(*(statement));
     }
@@ -82,144 +72,300 @@ void Interpreter::interpret(std::list<std::unique_ptr<Stmt>> statements)
   }
   catch (std::pair<Token, std::string>& tokStr)
   {
-    error(tokStr.first, tokStr.second);
+    reportError(tokStr.first, tokStr.second);
   }
+  catch (MemoryLimitError& error)
+  {
+    reportError(memoryLimitMessage(error.limit));
+  }
+  popFrame(scriptFrame);
+  memory.endRun();
+  stats.interpreterAllocations += stats.allocations - allocations;
 }
 
-void Interpreter::setEnv(const Environment& env)
+/* releases everything from base up and makes it the new top */
+void Interpreter::popFrame(Value* base)
 {
-  environment = env;
+  while (stackTop > base)
+    *--stackTop = Value();
 }
 
-Environment Interpreter::getEnv()
+Completion Interpreter::visitReturnStmt(Return& stmt)
 {
-  return environment;
+  if (stmt.isTailCall())
+  {
+    /* evaluate the call but let executeFunction make it in the current frame */
+    Call& call = static_cast<Call&>(stmt.getValue());
+    Value callee = evaluate(call.getCallee());
+    Value* args = pushArgs(call);
+    checkCall(call, callee, args, frame);
+    return { COMPLETION_TAIL_CALL, std::move(callee) };
+  }
+
+  return { COMPLETION_RETURN, evaluate(stmt.getValue()) };
 }
 
-std::any Interpreter::visitReturnStmt(Return& stmt)
+void Interpreter::define(const VarDecl& decl, const Token& name, Value value)
 {
-  std::any returnValue = evaluate(stmt.getValue());
-  throw returnValue;
+  if (decl.global)
+    globals.define(decl.slot, std::move(value));
+  else if (decl.boxed)
+    frame[decl.slot] = Value(new Cell(std::move(value)));
+  else
+    frame[decl.slot] = std::move(value);
 }
 
-std::any Interpreter::visitFunctionStmt(Function& stmt)
+Completion Interpreter::visitFunctionStmt(Function& stmt)
 {
-  environment.define(stmt.getName().lexeme, Callable(&stmt, &this->environment));
-  return std::any();
+  const VarDecl& decl = stmt.getDecl();
+  if (!decl.global && decl.boxed)
+  {
+    /* a local function that calls itself captures its own cell, so make that first */
+    Cell* cell = new Cell(Value());
+    frame[decl.slot] = Value(cell);
+    cell->value = Callable::closure(stmt.getInfo(), &stmt.getName(), frame, function);
+    return Completion();
+  }
+  define(decl, stmt.getName(), Callable::closure(stmt.getInfo(), &stmt.getName(), frame, function));
+  return Completion();
 }
 
-std::any Interpreter::visitBreakStmt(Break& stmt)
+Completion Interpreter::visitBreakStmt(Break& stmt)
 {
-  throw BREAK;
+  return { COMPLETION_BREAK };
 }
 
-std::any Interpreter::visitContinueStmt(Continue& stmt)
+Completion Interpreter::visitContinueStmt(Continue& stmt)
 {
-  throw CONTINUE;
+  return { COMPLETION_CONTINUE };
 }
 
-std::any Interpreter::visitWhileStmt(While& stmt)
+Completion Interpreter::visitWhileStmt(While& stmt)
 {
-  Environment currEnvironment = getEnv();
+  CountedLoop& loop = stmt.getCountedLoop();
+  if (loop.state == CountedLoop::UNSEEN)
+    loop.state = analyzeCountedLoop(stmt, loop) ? CountedLoop::COUNTED : CountedLoop::GENERIC;
+  if (loop.state == CountedLoop::COUNTED)
+  {
+    Completion completion;
+    if (runCounted(stmt, completion))
+      return completion;
+  }
+
   while (isTruthy(evaluate(stmt.getCondition())))
   {
-    try
+    Completion completion = execute(stmt.getBody());
+    if (completion.type == COMPLETION_BREAK)
+      break;
+    /* a return (or tail call) goes up to the call, continue just goes around again */
+    if (completion.type == COMPLETION_RETURN || completion.type == COMPLETION_TAIL_CALL)
+      return completion;
+  }
+
+  return Completion();
+}
+
+/*
+ * the counter lives in a double, only the body's other statements are
+ * executed and the slot gets the new count after each step so they still
+ * see it. false if the counter or the bound isn't a number right now, the
+ * generic loop then runs instead and fails the way it always did
+ */
+bool Interpreter::runCounted(While& stmt, Completion& completion)
+{
+  const CountedLoop& loop = stmt.getCountedLoop();
+  Value& counter = loop.counter.kind == VAR_LOCAL ? frame[loop.counter.index] : globals.at(loop.counter.index);
+  if (!counter.isNumber())
+    return false;
+  double bound = loop.boundValue;
+  if (!loop.boundIsLiteral)
+  {
+    const Value& value = loop.boundVar.kind == VAR_LOCAL ? frame[loop.boundVar.index] : globals.at(loop.boundVar.index);
+    if (!value.isNumber())
+      return false;
+    bound = value.asNumber();
+  }
+
+  const auto& statements = static_cast<Block&>(stmt.getBody()).getStatements();
+  size_t count = statements.size() - 1;
+  double i = counter.asNumber();
+  stats.countedLoops++;
+  for (;;)
+  {
+    bool more;
+    switch (loop.op)
+    {
+    case LESS:          more = i < bound; break;
+    case LESS_EQUAL:    more = i <= bound; break;
+    case GREATER:       more = i > bound; break;
+    default:            more = i >= bound; break;
+    }
+    if (!more)
+      break;
+    stats.countedIterations++;
+
+    Completion body;
+    for (size_t s = 0; s < count && body.type == COMPLETION_NORMAL; s++)
     {
-      execute(stmt.getBody());
+      if (statements[s] != nullptr)
+        body = execute(*statements[s]);
     }
-    catch (TokenType loopSignal)
+    if (body.type == COMPLETION_BREAK)
+      break;
+    if (body.type == COMPLETION_RETURN || body.type == COMPLETION_TAIL_CALL)
     {
-      if (loopSignal == BREAK)
-      {
-        setEnv(currEnvironment);
-        break;
-      }
-      else if (loopSignal == CONTINUE)
-      {
-        continue;
-      }
+      completion = std::move(body);
+      return true;
     }
+    /* continue skips the increment, same as the generic loop */
+    if (body.type == COMPLETION_CONTINUE)
+      continue;
+    i += loop.step;
+    counter = i;
   }
-
-  return std::any();
+  return true;
 }
 
-std::any Interpreter::visitIfStmt(If& stmt)
+Completion Interpreter::visitIfStmt(If& stmt)
 {
   if (isTruthy(evaluate(stmt.getCondition())))
-    execute(stmt.getThen());
+    return execute(stmt.getThen());
   else if (stmt.hasElse())
-    execute(stmt.getElse());
-  return std::any();
+    return execute(stmt.getElse());
+  return Completion();
 }
 
-std::any Interpreter::visitExpressionStmt(Expression& stmt)
+Completion Interpreter::visitExpressionStmt(Expression& stmt)
 {
   evaluate(stmt.getExpr());
-  return std::any();
+  return Completion();
 }
 
-std::any Interpreter::visitPrintStmt(Print& stmt)
+Completion Interpreter::visitPrintStmt(Print& stmt)
 {
-  std::cout << stringify(evaluate(stmt.getExpr())) << std::endl;
-  return std::any();
+  print(evaluate(stmt.getExpr()));
+  return Completion();
 }
 
-std::any Interpreter::visitVarStmt(Var& stmt)
+Completion Interpreter::visitVarStmt(Var& stmt)
 {
-  std::any value;
+  Value value;
   Expr& initializer = stmt.getInitializer();
   if (stmt.hasInitializer())
     value = evaluate(initializer);
-  environment.define(stmt.getName().lexeme, value);
-  return std::any();
+  define(stmt.getDecl(), stmt.getName(), std::move(value));
+  return Completion();
 }
 
-std::any Interpreter::visitBlockStmt(Block& stmt)
+Completion Interpreter::visitBlockStmt(Block& stmt)
 {
-  Environment thang = this->environment;
-  executeBlock(stmt.getStatements(), Environment(&thang));
-  this->environment = thang;
-  return std::any();
+  /* block locals already have slots in the frame, nothing to set up */
+  return executeBlock(stmt.getStatements());
 }
 
-std::any Interpreter::evaluate(Expr& expr)
+Value Interpreter::evaluate(Expr& expr)
 {
   return expr.accept(*this);
 }
 
-std::any Interpreter::execute(Stmt& stmt)
+Completion Interpreter::execute(Stmt& stmt)
 {
   return stmt.accept(*this);
 }
 
- void Interpreter::executeBlock(const std::vector<std::unique_ptr<Stmt>>& statements, Environment env)
+Completion Interpreter::executeBlock(const std::vector<std::unique_ptr<Stmt>>& statements)
 {
-   this->environment = env;
-
   // Reference (&) to the std::unique_ptr avoids the copying
   for (const auto& statement : statements)
   {
     if (statement != nullptr)
     {
-      execute(*statement);
+      Completion completion = execute(*statement);
+      if (completion.type != COMPLETION_NORMAL)
+        return completion;
     }
   }
+  return Completion();
 }
 
-std::any Interpreter::visitLogicalExpr(Logical& expr)
+/*
+ * runtime errors are still exceptions, but they abort the whole run and
+ * interpret() resets the stack, so there's nothing to clean up here
+ */
+Completion Interpreter::executeFunction(Callable* function, Value* frame)
 {
-  std::any left = evaluate(expr.getLeft());
+  Value* previousFrame = this->frame;
+  Callable* previousFunction = this->function;
+  this->frame = frame;
+  callDepth++;
+  memory.pushFrame(frameBytes(function->getInfo()));
+
+  /* holds on to the callee of a tail call, the old frame might have been the last reference */
+  Value tailCallee;
+  Completion completion;
+  for (;;)
+  {
+    FunctionInfo& info = function->getInfo();
+    this->function = function;
+    /* the args are already in place, the rest of the locals are nil */
+    stackTop = frame + info.slotCount;
+    for (int slot : info.boxedParams)
+      frame[slot] = Value(new Cell(frame[slot]));
+
+    completion = executeBlock(info.getBody());
+    if (completion.type != COMPLETION_TAIL_CALL)
+      break;
+
+    /*
+     * return f(...); left f's args on top of the stack. move them down
+     * into this frame and go around again instead of recursing, so tail
+     * calls run in constant C++ stack and frame stack
+     */
+    memory.popFrame(frameBytes(function->getInfo()));
+    tailCallee = std::move(completion.value);
+    function = tailCallee.asCallable();
+    memory.pushFrame(frameBytes(function->getInfo()));
+    Value* args = stackTop - function->getArity();
+    for (int i = 0; i < function->getArity(); i++)
+      frame[i] = std::move(args[i]);
+    popFrame(frame + function->getArity());
+    stats.calls++;
+  }
+
+  popFrame(frame);
+  memory.popFrame(frameBytes(function->getInfo()));
+  callDepth--;
+  this->frame = previousFrame;
+  this->function = previousFunction;
+  return completion;
+}
+
+Value Interpreter::visitLogicalExpr(Logical& expr)
+{
+  Value left = evaluate(expr.getLeft());
+  Specialization& spec = expr.getSpecialization();
+  bool truthy;
+  if (spec == SPEC_BOOL_LOGICAL && left.isBool())
+    truthy = left.asBool();
+  else
+  {
+    if (spec == SPEC_UNSEEN)
+      specialize(spec, left.isBool() ? SPEC_BOOL_LOGICAL : SPEC_GENERIC);
+    else if (spec != SPEC_GENERIC)
+      deoptimize(spec);
+    truthy = isTruthy(left);
+  }
+
   if (expr.getOp().type == OR)
   {
-    if (isTruthy(left))
+    if (truthy)
     {
       return left;
     }
   }
   else
   {
-    if (!isTruthy(left))
+    if (!truthy)
     {
       return left;
     }
@@ -228,10 +374,84 @@ std::any Interpreter::visitLogicalExpr(Logical& expr)
   return evaluate(expr.getRight());
 }
 
-std::any Interpreter::visitBinaryExpr(Binary& expr)
+/* what a Binary that saw these operands specializes to */
+static Specialization binarySpecialization(TokenType op, const Value& left, const Value& right)
+{
+  if (op == PLUS && left.isString() && right.isString())
+    return SPEC_STRING_CONCAT;
+  if (!left.isNumber() || !right.isNumber())
+    return SPEC_GENERIC;
+
+  switch (op)
+  {
+  case PLUS:          return SPEC_NUMBER_ADD;
+  case MINUS:         return SPEC_NUMBER_SUBTRACT;
+  case STAR:          return SPEC_NUMBER_MULTIPLY;
+  case SLASH:         return SPEC_NUMBER_DIVIDE;
+  case GREATER:       return SPEC_NUMBER_GREATER;
+  case GREATER_EQUAL: return SPEC_NUMBER_GREATER_EQUAL;
+  case LESS:          return SPEC_NUMBER_LESS;
+  case LESS_EQUAL:    return SPEC_NUMBER_LESS_EQUAL;
+  case EQUAL_EQUAL:   return SPEC_NUMBER_EQUAL;
+  case BANG_EQUAL:    return SPEC_NUMBER_NOT_EQUAL;
+  default:            return SPEC_GENERIC;
+  }
+}
+
+void Interpreter::specialize(Specialization& spec, Specialization to)
+{
+  spec = to;
+  if (to != SPEC_GENERIC)
+    stats.specializations++;
+}
+
+/* the types changed under a specialized node, it stays generic from now on */
+void Interpreter::deoptimize(Specialization& spec)
+{
+  spec = SPEC_GENERIC;
+  stats.deoptimizations++;
+}
+
+#define specializedNumbers(l, r, oprand) \
+if (l.isNumber() && r.isNumber()) \
+  return l.asNumber() oprand r.asNumber(); \
+break
+
+Value Interpreter::visitBinaryExpr(Binary& expr)
 {
-  std::any left = evaluate(expr.getLeft());
-  std::any right = evaluate(expr.getRight());
+  Value left = evaluate(expr.getLeft());
+  Value right = evaluate(expr.getRight());
+
+  Specialization& spec = expr.getSpecialization();
+  switch (spec)
+  {
+  case SPEC_NUMBER_ADD:           specializedNumbers(left, right, +);
+  case SPEC_NUMBER_SUBTRACT:      specializedNumbers(left, right, -);
+  case SPEC_NUMBER_MULTIPLY:      specializedNumbers(left, right, *);
+  case SPEC_NUMBER_GREATER:       specializedNumbers(left, right, >);
+  case SPEC_NUMBER_GREATER_EQUAL: specializedNumbers(left, right, >=);
+  case SPEC_NUMBER_LESS:          specializedNumbers(left, right, <);
+  case SPEC_NUMBER_LESS_EQUAL:    specializedNumbers(left, right, <=);
+  case SPEC_NUMBER_EQUAL:         specializedNumbers(left, right, ==);
+  case SPEC_NUMBER_NOT_EQUAL:     specializedNumbers(left, right, !=);
+  case SPEC_NUMBER_DIVIDE:
+    /* dividing by zero is still the generic path's error */
+    if (left.isNumber() && right.isNumber() && right.asNumber() != 0)
+      return left.asNumber() / right.asNumber();
+    break;
+  case SPEC_STRING_CONCAT:
+    /* addValues, so going over --mem-limit reports the + */
+    if (left.isString() && right.isString())
+      return addValues(expr.getOp(), left, right);
+    break;
+  default:
+    break;
+  }
+
+  if (spec == SPEC_UNSEEN)
+    specialize(spec, binarySpecialization(expr.getOp().type, left, right));
+  else if (spec != SPEC_GENERIC && !(spec == SPEC_NUMBER_DIVIDE && left.isNumber() && right.isNumber()))
+    deoptimize(spec);
 
   switch (expr.getOp().type)
   {
@@ -246,81 +466,222 @@ std::any Interpreter::visitBinaryExpr(Binary& expr)
   case STAR:          checkNumbers(expr.getOp(), left, right, *);
   case SLASH:
     checkNumberOperands(expr.getOp(), left, right);
-    if (std::any_cast<double>(right) == 0)
+    if (right.asNumber() == 0)
       throw std::make_pair(expr.getOp(), std::string("Check your math big man!! you cant divide a number by 0"));
-    return std::any_cast<double>(left) / std::any_cast<double>(right);
+    return left.asNumber() / right.asNumber();
   case PLUS:
-    if (left.type() == typeid(double) && right.type() == typeid(double))
-      return std::any_cast<double>(left) + std::any_cast<double>(right);
-    if (left.type() == typeid(std::string) && right.type() == typeid(std::string))
-      return std::any_cast<std::string>(left).append(std::any_cast<std::string>(right));
-    if (left.type() == typeid(std::string) && right.type() == typeid(double))
-      return std::any_cast<std::string>(left).append(std::to_string(std::any_cast<double>(right)));
-    if (left.type() == typeid(double) && right.type() == typeid(std::string))
-      return std::to_string(std::any_cast<double>(left)).append(std::any_cast<std::string>(right));
-    throw std::make_pair(expr.getOp(), std::string("Operands must be FUCKING NUMBERS or FUCKING STRINGS"));
+    if (left.isNumber() && right.isNumber())
+      return left.asNumber() + right.asNumber();
+    return addValues(expr.getOp(), left, right);
   }
 
-  return std::any();
+  return Value();
 }
 
-std::any Interpreter::visitGroupingExpr(Grouping& expr)
+Value Interpreter::visitGroupingExpr(Grouping& expr)
 {
   return evaluate(expr.getExpr());
 }
 
-std::any Interpreter::visitLiteralExpr(Literal& expr)
+Value Interpreter::visitLiteralExpr(Literal& expr)
 {
   return expr.getLit();
 }
 
-std::any Interpreter::visitCallExpr(Call& expr)
+/* the args go straight into the first slots of the callee's frame */
+Value* Interpreter::pushArgs(Call& expr)
+{
+  Value* args = stackTop;
+  Value* stackEnd = stack.data() + stack.size();
+  for (const auto& arg : expr.getArgs())
+  {
+    Value value = evaluate(*arg);
+    if (stackTop == stackEnd)
+      throw std::make_pair(expr.getParen(), std::string("Stack overflow."));
+    *stackTop++ = std::move(value);
+  }
+  return args;
+}
+
+/* frame is where the callee's frame will start, args for a normal call */
+Callable* Interpreter::checkCall(Call& expr, const Value& callee, Value* args, Value* frame)
+{
+  CallCache& cache = expr.getCache();
+  Callable* function;
+  if (callee.isCallable() && &callee.asCallable()->getInfo() == cache.info)
+  {
+    stats.callCacheHits++;
+    function = callee.asCallable();
+  }
+  else
+  {
+    if (!callee.isCallable())
+      throw std::make_pair(expr.getParen(), std::string("Object called is not a function")); 
+
+    function = callee.asCallable();
+    if (stackTop - args != function->getArity())
+      throw std::make_pair(expr.getParen(), std::string("Invalid number of arguments")); 
+    stats.callCacheMisses++;
+    cache.info = &function->getInfo();
+    cache.inlining = CallCache::INLINE_UNSEEN;
+  }
+
+  if (stack.data() + stack.size() - frame < function->getInfo().slotCount || callDepth == MAX_CALL_DEPTH)
+    throw std::make_pair(expr.getParen(), std::string("Stack overflow."));
+  if (!memory.fitsFrame(frameBytes(function->getInfo())))
+    throw std::make_pair(expr.getParen(), memoryLimitMessage(memory.getLimit()));
+  return function;
+}
+
+Value Interpreter::visitCallExpr(Call& expr)
 {
   /* lookup function from variable */
-  std::any callee = evaluate(expr.getCallee());
+  Value callee = evaluate(expr.getCallee());
+  Value* args = pushArgs(expr);
+  Callable* function = checkCall(expr, callee, args, args);
+  stats.calls++;
 
-  std::vector<std::any> args;
-  for (const auto& arg : expr.getArgs())
+  CallCache& cache = expr.getCache();
+  if (cache.inlining == CallCache::INLINE_UNSEEN)
   {
-    args.push_back(evaluate(*arg));
+    Variable* variable = dynamic_cast<Variable*>(&expr.getCallee());
+    bool global = variable != nullptr && variable->getRef().kind == VAR_GLOBAL;
+    cache.inlining = inlineSize > 0 && global && canInline(function->getInfo(), variable->getRef().index, inlineSize)
+      ? CallCache::INLINE_YES : CallCache::INLINE_NO;
   }
+  if (cache.inlining == CallCache::INLINE_YES && inlineNesting < inlineDepth)
+    return inlineCall(function, args);
 
-  if (callee.type() != typeid(Callable))
-    throw std::make_pair(expr.getParen(), std::string("Object called is not a function")); 
+  Value native;
+  if (jitMode != JIT_OFF && jit.call(function, args, callDepth, stack.data() + stack.size() - args, native))
+  {
+    if (jitMode == JIT_VERIFY)
+      return verifyNative(expr, function, args, native);
+    popFrame(args);
+    return native;
+  }
+  return function->call(*this, args);
+}
 
-  if (args.size() != std::any_cast<Callable>(callee).getArity())
-    throw std::make_pair(expr.getParen(), std::string("Invalid number of arguments")); 
-  return std::any_cast<Callable>(callee).call(*this, args);
+/*
+ * runs the body of a function canInline() accepted with args as its
+ * frame. it has no closure and makes none, so unlike executeFunction
+ * this doesn't switch the running function, and a return in it is just
+ * its value, canInline() leaves out tail calls
+ */
+Value Interpreter::inlineCall(Callable* function, Value* args)
+{
+  const InlineInfo& inlining = function->getInfo().inlining;
+  Value* previousFrame = frame;
+  frame = args;
+  stackTop = args + function->getInfo().slotCount;
+  callDepth++;
+  memory.pushFrame(frameBytes(function->getInfo()));
+  inlineNesting++;
+  stats.inlinedCalls++;
+
+  Value result;
+  if (inlining.value != nullptr)
+    result = evaluate(*inlining.value);
+  else
+    execute(*inlining.body);
+
+  inlineNesting--;
+  memory.popFrame(frameBytes(function->getInfo()));
+  callDepth--;
+  popFrame(args);
+  frame = previousFrame;
+  return result;
 }
 
-std::any Interpreter::visitUnaryExpr(Unary& expr)
+/* --jit=verify, makes the call again without the JIT and compares */
+Value Interpreter::verifyNative(Call& expr, Callable* function, Value* args, const Value& native)
 {
-  std::any right = evaluate(expr.getRight());
+  jitMode = JIT_OFF;
+  Value interpreted;
+  try
+  {
+    interpreted = function->call(*this, args);
+  }
+  catch (...)
+  {
+    jitMode = JIT_VERIFY;
+    throw;
+  }
+  jitMode = JIT_VERIFY;
+
+  bool same = interpreted.isNumber() &&
+    (native.asNumber() == interpreted.asNumber() || (std::isnan(native.asNumber()) && std::isnan(interpreted.asNumber())));
+  if (!same)
+  {
+    output->flush();
+    std::cerr << "JIT MISMATCH: [" << expr.getParen().line << "] " << function->toString() << " returned "
+              << native.asNumber() << " natively" << std::endl;
+  }
+  return interpreted;
+}
+
+Value Interpreter::visitUnaryExpr(Unary& expr)
+{
+  Value right = evaluate(expr.getRight());
+
+  Specialization& spec = expr.getSpecialization();
+  if (spec == SPEC_NUMBER_NEGATE && right.isNumber())
+    return -right.asNumber();
+  if (spec == SPEC_BOOL_NOT && right.isBool())
+    return !right.asBool();
+
+  if (spec == SPEC_UNSEEN)
+  {
+    if (expr.getOp().type == MINUS && right.isNumber())
+      specialize(spec, SPEC_NUMBER_NEGATE);
+    else if (expr.getOp().type == BANG && right.isBool())
+      specialize(spec, SPEC_BOOL_NOT);
+    else
+      specialize(spec, SPEC_GENERIC);
+  }
+  else if (spec != SPEC_GENERIC)
+    deoptimize(spec);
 
   switch (expr.getOp().type)
   {
   case BANG:
     return !isTruthy(right);
   case MINUS:
-    return -std::any_cast<double>(right);
+    checkNumberOperand(expr.getOp(), right);
+    return -right.asNumber();
   }
 
-  return std::any(nullptr);
+  return Value();
 }
 
-std::any Interpreter::visitVariableExpr(Variable& expr)
+Value Interpreter::visitVariableExpr(Variable& expr)
 {
-  return environment.get(expr.getName());
+  const VarRef& ref = expr.getRef();
+  switch (ref.kind)
+  {
+  case VAR_LOCAL:   return frame[ref.index];
+  case VAR_CELL:    return cellValue(frame[ref.index]);
+  case VAR_UPVALUE: return function->getUpvalue(ref.index)->value;
+  default:          return globals.get(ref.index, expr.getName());
+  }
 }
 
-std::any Interpreter::visitAssignExpr(Assign& expr)
+Value Interpreter::visitAssignExpr(Assign& expr)
 {
-  std::any lit = evaluate(expr.getValue());
-  environment.assign(expr.getName(), lit);
+  Value lit = evaluate(expr.getValue());
+  const VarRef& ref = expr.getRef();
+  switch (ref.kind)
+  {
+  case VAR_LOCAL:   frame[ref.index] = lit; break;
+  case VAR_CELL:    cellValue(frame[ref.index]) = lit; break;
+  case VAR_UPVALUE: function->getUpvalue(ref.index)->value = lit; break;
+  default:          globals.assign(ref.index, expr.getName(), lit); break;
+  }
   return lit;
 }
 
-std::any Interpreter::visitLambdaExpr(Lambda& expr)
+Value Interpreter::visitLambdaExpr(Lambda& expr)
 {
-  return Callable(&expr, &this->environment);
+  return Callable::closure(expr.getInfo(), nullptr, frame, function);
 }
\ No newline at end of file
@@ -1,38 +1,69 @@
 #pragma once
 
-#include "Stmt.h"
-#include "Environment.h"
-#include <list>
+#include "Engine.h"
+#include "Jit.h"
 
-class Interpreter : public ExprVisitor<std::any>, public StmtVisitor<std::any>
+/* the tree walker, runs the AST directly (--engine=tree, the default) */
+class Interpreter : public Engine, public ExprVisitor<Value>, public StmtVisitor<Completion>
 {
 public:
-	void interpret(std::list<std::unique_ptr<Stmt>> statements);
-	void setEnv(const Environment &env);
-	Environment getEnv();
-  	void executeBlock(const std::vector<std::unique_ptr<Stmt>>& statements, Environment env);
+	Interpreter();
+	void interpret(std::unique_ptr<Program> program, int slotCount) override;
+	Completion executeBlock(const std::vector<std::unique_ptr<Stmt>>& statements);
+	Completion executeFunction(Callable* function, Value* frame);
+	/* --jit, on by default where there is a JIT */
+	void setJitMode(JitMode mode);
+	/* --inline-size and --inline-depth, a size of 0 turns inlining off */
+	void setInlineLimits(int maxSize, int maxDepth);
 private:
-	std::any execute(Stmt& stmt);
-	std::any evaluate(Expr& expr);
-	std::any visitReturnStmt(Return& stmt) override;
-	std::any visitFunctionStmt(Function& stmt) override;
-	std::any visitBreakStmt(Break& stmt) override;
-	std::any visitContinueStmt(Continue& stmt) override;
-	std::any visitWhileStmt(While& stmt) override;
-	std::any visitIfStmt(If& stmt) override;
-	std::any visitExpressionStmt(Expression& stmt) override;
-	std::any visitPrintStmt(Print& stmt) override;
-	std::any visitVarStmt(Var& stmt) override;
-	std::any visitBlockStmt(Block& stmt) override;
-	std::any visitCallExpr(Call& expr) override;
-	std::any visitLogicalExpr(Logical& expr) override;
-	std::any visitBinaryExpr(Binary& expr) override;
-	std::any visitGroupingExpr(Grouping& expr) override;
-	std::any visitLiteralExpr(Literal& expr) override;
-	std::any visitUnaryExpr(Unary& expr) override;
-	std::any visitVariableExpr(Variable& expr) override;
-	std::any visitAssignExpr(Assign& expr) override;
-	std::any visitLambdaExpr(Lambda& expr) override;
+	Completion execute(Stmt& stmt);
+	Value evaluate(Expr& expr);
+	void define(const VarDecl& decl, const Token& name, Value value);
+	void popFrame(Value* base);
+	Value* pushArgs(Call& expr);
+	Callable* checkCall(Call& expr, const Value& callee, Value* args, Value* frame);
+	void specialize(Specialization& spec, Specialization to);
+	void deoptimize(Specialization& spec);
+	Value verifyNative(Call& expr, Callable* function, Value* args, const Value& native);
+	bool runCounted(While& stmt, Completion& completion);
+	Value inlineCall(Callable* function, Value* args);
+	Completion visitReturnStmt(Return& stmt) override;
+	Completion visitFunctionStmt(Function& stmt) override;
+	Completion visitBreakStmt(Break& stmt) override;
+	Completion visitContinueStmt(Continue& stmt) override;
+	Completion visitWhileStmt(While& stmt) override;
+	Completion visitIfStmt(If& stmt) override;
+	Completion visitExpressionStmt(Expression& stmt) override;
+	Completion visitPrintStmt(Print& stmt) override;
+	Completion visitVarStmt(Var& stmt) override;
+	Completion visitBlockStmt(Block& stmt) override;
+	Value visitCallExpr(Call& expr) override;
+	Value visitLogicalExpr(Logical& expr) override;
+	Value visitBinaryExpr(Binary& expr) override;
+	Value visitGroupingExpr(Grouping& expr) override;
+	Value visitLiteralExpr(Literal& expr) override;
+	Value visitUnaryExpr(Unary& expr) override;
+	Value visitVariableExpr(Variable& expr) override;
+	Value visitAssignExpr(Assign& expr) override;
+	Value visitLambdaExpr(Lambda& expr) override;
 private:
-	Environment environment;
+	/*
+	 * every frame lives on this stack, callers evaluate the arguments
+	 * straight into the first slots of the callee's frame so a call
+	 * doesn't allocate. slots above stackTop are always nil.
+	 */
+	std::vector<Value> stack;
+	Value* stackTop;
+	/* calls also recurse on the C++ stack, MAX_CALL_DEPTH stops before that runs out */
+	int callDepth = 0;
+	/* slots of the running function (or the top-level script) */
+	Value* frame = nullptr;
+	/* the running closure, null at top level */
+	Callable* function = nullptr;
+	Jit jit;
+	JitMode jitMode;
+	/* see Inliner.h, inlineNesting is how many inlined bodies are running inside each other */
+	int inlineSize = 16;
+	int inlineDepth = 4;
+	int inlineNesting = 0;
 };
@@ -0,0 +1,763 @@
+#include "Jit.h"
+#include "Callable.h"
+#include "Stats.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_X86_64
+#endif
+
+#ifdef JIT_X86_64
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+
+namespace
+{
+
+/* shared by native code and the runtime, the code has its address baked in */
+struct JitState
+{
+  int32_t depth;
+  int32_t maxDepth;
+  /* frame stack slots the interpreter would be using, see JitCompiler::compile */
+  int64_t slots;
+  int64_t maxSlots;
+  uint8_t bailedOut;
+};
+static_assert(offsetof(JitState, depth) == 0 && offsetof(JitState, maxDepth) == 4 &&
+              offsetof(JitState, slots) == 8 && offsetof(JitState, maxSlots) == 16 &&
+              offsetof(JitState, bailedOut) == 24, "native code hardcodes these offsets");
+
+JitState state;
+/* the Jit whose native code is running, for nativeCallee */
+Jit* running = nullptr;
+
+/* params past the arity land in registers the code never reads */
+using NativeFunction = double (*)(double, double, double, double, double, double);
+
+/*
+ * called from native code for every call: the native code of the
+ * global in slot, or null when there isn't any and the caller has to
+ * give up
+ */
+void* nativeCallee(int32_t slot, int32_t argCount)
+{
+  const Value& callee = running->globals.at(slot);
+  if (!callee.isCallable() || callee.asCallable()->getArity() != argCount)
+    return nullptr;
+  void* code = running->compile(callee.asCallable()->getInfo());
+  if (code != nullptr)
+  {
+    stats.calls++;
+    stats.nativeCalls++;
+  }
+  return code;
+}
+
+enum Cond : uint8_t
+{
+  CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7, CC_P = 0xa, CC_G = 0xf
+};
+
+/* a jump target, jumps to it from before bind() get patched then */
+struct Label
+{
+  int offset = -1;
+  std::vector<int> patches;
+};
+
+/*
+ * Just the x86-64 the compiler below needs. Values are doubles in xmm
+ * registers (0-7, no REX needed), locals are at rbp - 8 * (slot + 1),
+ * rax/rcx/rdx are scratch.
+ */
+class Assembler
+{
+public:
+  std::vector<uint8_t> code;
+
+  void emit(std::initializer_list<uint8_t> bytes)
+  {
+    code.insert(code.end(), bytes);
+  }
+
+  void imm32(int32_t value)
+  {
+    for (int i = 0; i < 4; i++)
+      code.push_back((uint32_t)value >> (8 * i));
+  }
+
+  void imm64(uint64_t value)
+  {
+    for (int i = 0; i < 8; i++)
+      code.push_back(value >> (8 * i));
+  }
+
+  void jump(Label& label)
+  {
+    emit({ 0xe9 });
+    target(label);
+  }
+
+  void jump(Cond cc, Label& label)
+  {
+    emit({ 0x0f, (uint8_t)(0x80 | cc) });
+    target(label);
+  }
+
+  void bind(Label& label)
+  {
+    label.offset = code.size();
+    for (int at : label.patches)
+      patch(at, label.offset);
+  }
+
+  /* mov rax/rcx, imm64 */
+  void movRax(uint64_t value) { emit({ 0x48, 0xb8 }); imm64(value); }
+  void movRcx(const void* ptr) { emit({ 0x48, 0xb9 }); imm64((uint64_t)ptr); }
+
+  /* movsd xmm, [rbp - 8 * (slot + 1)] and back */
+  void loadLocal(int xmm, int slot) { emit({ 0xf2, 0x0f, 0x10, (uint8_t)(0x85 | xmm << 3) }); imm32(-8 * (slot + 1)); }
+  void storeLocal(int slot, int xmm) { emit({ 0xf2, 0x0f, 0x11, (uint8_t)(0x85 | xmm << 3) }); imm32(-8 * (slot + 1)); }
+
+  void loadNumber(int xmm, double number)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof bits);
+    movRax(bits);
+    movqXmmRax(xmm);
+  }
+
+  void movqRaxXmm(int xmm) { emit({ 0x66, 0x48, 0x0f, 0x7e, (uint8_t)(0xc0 | xmm << 3) }); }
+  void movqXmmRax(int xmm) { emit({ 0x66, 0x48, 0x0f, 0x6e, (uint8_t)(0xc0 | xmm << 3) }); }
+
+  /* addsd, subsd, mulsd, divsd, ucomisd, xorpd, movapd xmm, xmm */
+  void sse(uint8_t prefix, uint8_t op, int dst, int src) { emit({ prefix, 0x0f, op, (uint8_t)(0xc0 | dst << 3 | src) }); }
+private:
+  void target(Label& label)
+  {
+    int at = code.size();
+    imm32(0);
+    if (label.offset >= 0)
+      patch(at, label.offset);
+    else
+      label.patches.push_back(at);
+  }
+
+  void patch(int at, int to)
+  {
+    int32_t rel = to - (at + 4);
+    std::memcpy(&code[at], &rel, sizeof rel);
+  }
+};
+
+enum : uint8_t
+{
+  SSE_ADD = 0x58, SSE_MUL = 0x59, SSE_SUB = 0x5c, SSE_DIV = 0x5e,
+  SSE_MOVAPD = 0x28, SSE_UCOMISD = 0x2e, SSE_XORPD = 0x57
+};
+
+/*
+ * One function body to machine code, in a single pass. Expressions leave
+ * their result in xmm0, the left side of a binary expression waits on
+ * the machine stack while the right side runs unless the right side is
+ * just a local or a literal. Visiting anything native code can't do
+ * clears supported, the code is thrown away then.
+ */
+class JitCompiler : public ExprVisitor<Value>, public StmtVisitor<Completion>
+{
+public:
+  JitCompiler(FunctionInfo& info) : info(info) {}
+
+  bool compile()
+  {
+    if (!info.captures.empty() || info.getArity() > Jit::MAX_ARITY)
+      return false;
+
+    /* push rbp; mov rbp, rsp; sub rsp, frame (rsp stays 16 byte aligned) */
+    a.emit({ 0x55, 0x48, 0x89, 0xe5, 0x48, 0x81, 0xec });
+    a.imm32((info.slotCount * 8 + 15) & ~15);
+
+    /*
+     * count the call like the interpreter would, depth and frame stack
+     * slots. a frame needs its slots plus, at most, the args of every
+     * call in it waiting on the stack at once
+     */
+    a.movRcx(&state);
+    a.emit({ 0xff, 0x01 });                          /* inc dword [rcx] */
+    a.emit({ 0x48, 0x81, 0x41, 0x08 });              /* add qword [rcx + 8], cost */
+    int costAt = a.code.size();
+    a.imm32(0);
+    a.emit({ 0x8b, 0x01, 0x3b, 0x41, 0x04 });        /* mov eax, [rcx]; cmp eax, [rcx + 4] */
+    a.jump(CC_G, bail);
+    a.emit({ 0x48, 0x8b, 0x41, 0x08, 0x48, 0x3b, 0x41, 0x10 }); /* mov rax, [rcx + 8]; cmp rax, [rcx + 16] */
+    a.jump(CC_G, bail);
+
+    for (int i = 0; i < info.getArity(); i++)
+      a.storeLocal(i, i);
+    a.bind(body);
+    for (const auto& statement : info.getBody())
+    {
+      if (statement != nullptr)
+        statement->accept(*this);
+    }
+    /* ran off the end, that returns nil */
+    a.jump(bail);
+
+    a.bind(bail);
+    a.movRcx(&state);
+    a.emit({ 0xc6, 0x41, 0x18, 0x01 });              /* mov byte [rcx + 24], 1 */
+    a.bind(exit);
+    a.movRcx(&state);
+    a.emit({ 0xff, 0x09 });                          /* dec dword [rcx] */
+    a.emit({ 0x48, 0x81, 0x69, 0x08 });              /* sub qword [rcx + 8], cost */
+    int costAt2 = a.code.size();
+    a.imm32(0);
+    a.emit({ 0xc9, 0xc3 });                          /* leave; ret */
+
+    int32_t cost = info.slotCount + argSlots;
+    std::memcpy(&a.code[costAt], &cost, sizeof cost);
+    std::memcpy(&a.code[costAt2], &cost, sizeof cost);
+    return supported;
+  }
+
+  Assembler a;
+private:
+  struct Loop
+  {
+    Loop* enclosing;
+    Label start;
+    Label end;
+  };
+
+  void compile(Expr& expr)
+  {
+    expr.accept(*this);
+  }
+
+  void pushXmm0()
+  {
+    a.movqRaxXmm(0);
+    a.emit({ 0x50 });                                /* push rax */
+    pushed++;
+  }
+
+  void popXmm(int xmm)
+  {
+    a.emit({ 0x58 });                                /* pop rax */
+    a.movqXmmRax(xmm);
+    pushed--;
+  }
+
+  /* call rax, with rsp 16 byte aligned like the ABI wants */
+  void callRax()
+  {
+    if (pushed % 2 != 0)
+      a.emit({ 0x48, 0x83, 0xec, 0x08 });            /* sub rsp, 8 */
+    a.emit({ 0xff, 0xd0 });
+    if (pushed % 2 != 0)
+      a.emit({ 0x48, 0x83, 0xc4, 0x08 });            /* add rsp, 8 */
+  }
+
+  /* the callee's native code in rax, then the args on the stack above it */
+  void pushCall(Call& call)
+  {
+    Variable* callee = dynamic_cast<Variable*>(&call.getCallee());
+    int argCount = call.getArgs().size();
+    if (callee == nullptr || callee->getRef().kind != VAR_GLOBAL || argCount > Jit::MAX_ARITY)
+    {
+      supported = false;
+      return;
+    }
+    argSlots += argCount;
+
+    a.emit({ 0xbf });                                /* mov edi, slot */
+    a.imm32(callee->getRef().index);
+    a.emit({ 0xbe });                                /* mov esi, argCount */
+    a.imm32(argCount);
+    a.movRax((uint64_t)&nativeCallee);
+    callRax();
+    a.emit({ 0x48, 0x85, 0xc0 });                    /* test rax, rax */
+    a.jump(CC_E, bail);
+    a.emit({ 0x50 });
+    pushed++;
+    for (const auto& arg : call.getArgs())
+    {
+      compile(*arg);
+      pushXmm0();
+    }
+  }
+
+  /* after pushCall, the args into xmm0.. and the callee into rax */
+  void popCall(int argCount)
+  {
+    for (int i = argCount - 1; i >= 0; i--)
+      popXmm(i);
+    a.emit({ 0x58 });
+    pushed--;
+  }
+
+  /* the callee gave up if it set bailedOut, so give up too */
+  void callNative()
+  {
+    callRax();
+    a.movRcx(&state);
+    a.emit({ 0x80, 0x79, 0x18, 0x00 });              /* cmp byte [rcx + 24], 0 */
+    a.jump(CC_NE, bail);
+  }
+
+  /* a local or a number literal, loaded straight into xmm1 */
+  bool isSimple(Expr& expr)
+  {
+    if (Variable* variable = dynamic_cast<Variable*>(&expr))
+      return variable->getRef().kind == VAR_LOCAL;
+    if (Literal* literal = dynamic_cast<Literal*>(&expr))
+      return literal->getLit().isNumber();
+    return false;
+  }
+
+  /* left into xmm0, right into xmm1 */
+  void operands(Binary& expr)
+  {
+    compile(expr.getLeft());
+    Expr& right = expr.getRight();
+    if (Variable* variable = dynamic_cast<Variable*>(&right); variable != nullptr && isSimple(right))
+    {
+      a.loadLocal(1, variable->getRef().index);
+      return;
+    }
+    if (Literal* literal = dynamic_cast<Literal*>(&right); literal != nullptr && isSimple(right))
+    {
+      a.loadNumber(1, literal->getLit().asNumber());
+      return;
+    }
+    pushXmm0();
+    compile(right);
+    a.sse(0x66, SSE_MOVAPD, 1, 0);
+    popXmm(0);
+  }
+
+  /* after ucomisd xmm0, xmm1. unordered (a NaN) sets ZF too, so check PF */
+  void jumpIfEqual(bool equal, Label& target)
+  {
+    if (!equal)
+    {
+      a.jump(CC_P, target);
+      a.jump(CC_NE, target);
+      return;
+    }
+    Label skip;
+    a.jump(CC_P, skip);
+    a.jump(CC_E, target);
+    a.bind(skip);
+  }
+
+  /* jumps to target if expr is truthy == when, falls through otherwise */
+  void condition(Expr& expr, bool when, Label& target)
+  {
+    if (Grouping* grouping = dynamic_cast<Grouping*>(&expr))
+      return condition(grouping->getExpr(), when, target);
+
+    if (Unary* unary = dynamic_cast<Unary*>(&expr); unary != nullptr && unary->getOp().type == BANG)
+      return condition(unary->getRight(), !when, target);
+
+    if (Literal* literal = dynamic_cast<Literal*>(&expr))
+    {
+      if (isTruthy(literal->getLit()) == when)
+        a.jump(target);
+      return;
+    }
+
+    if (Logical* logical = dynamic_cast<Logical*>(&expr))
+    {
+      bool isOr = logical->getOp().type == OR;
+      if (isOr == when)
+      {
+        condition(logical->getLeft(), when, target);
+        condition(logical->getRight(), when, target);
+        return;
+      }
+      Label skip;
+      condition(logical->getLeft(), !when, skip);
+      condition(logical->getRight(), when, target);
+      a.bind(skip);
+      return;
+    }
+
+    Binary* binary = dynamic_cast<Binary*>(&expr);
+    TokenType op = binary != nullptr ? binary->getOp().type : PLUS;
+    switch (op)
+    {
+    /* a < b is b > a, so unordered comes out false for all four */
+    case GREATER:
+    case LESS:
+      operands(*binary);
+      a.sse(0x66, SSE_UCOMISD, op == GREATER ? 0 : 1, op == GREATER ? 1 : 0);
+      a.jump(when ? CC_A : CC_BE, target);
+      return;
+    case GREATER_EQUAL:
+    case LESS_EQUAL:
+      operands(*binary);
+      a.sse(0x66, SSE_UCOMISD, op == GREATER_EQUAL ? 0 : 1, op == GREATER_EQUAL ? 1 : 0);
+      a.jump(when ? CC_AE : CC_B, target);
+      return;
+    case EQUAL_EQUAL:
+    case BANG_EQUAL:
+      operands(*binary);
+      a.sse(0x66, SSE_UCOMISD, 0, 1);
+      jumpIfEqual((op == EQUAL_EQUAL) == when, target);
+      return;
+    default:
+      break;
+    }
+
+    /* anything else is a number, and those are always truthy */
+    compile(expr);
+    if (when)
+      a.jump(target);
+  }
+
+  void unsupported()
+  {
+    supported = false;
+  }
+
+  Completion visitReturnStmt(Return& stmt) override
+  {
+    if (stmt.isTailCall())
+    {
+      tailCall(static_cast<Call&>(stmt.getValue()));
+      return Completion();
+    }
+    compile(stmt.getValue());
+    a.jump(exit);
+    return Completion();
+  }
+
+  /*
+   * return f(...) where f turns out to be this function stores the args
+   * in the params and jumps back to the top, like the interpreter reuses
+   * the frame. anything else falls through to a normal call
+   */
+  void tailCall(Call& call)
+  {
+    int argCount = call.getArgs().size();
+    pushCall(call);
+    if (!supported)
+      return;
+    a.emit({ 0x48, 0x8d, 0x15 });                    /* lea rdx, [rip + start of the function] */
+    a.imm32(-(int32_t)(a.code.size() + 4));
+    a.emit({ 0x48, 0x8b, 0x84, 0x24 });              /* mov rax, [rsp + 8 * argCount] */
+    a.imm32(8 * argCount);
+    a.emit({ 0x48, 0x39, 0xd0 });                    /* cmp rax, rdx */
+    Label other;
+    a.jump(CC_NE, other);
+
+    popCall(argCount);
+    for (int i = 0; i < argCount; i++)
+      a.storeLocal(i, i);
+    a.jump(body);
+
+    a.bind(other);
+    pushed += argCount + 1;
+    popCall(argCount);
+    callNative();
+    a.jump(exit);
+  }
+
+  Completion visitFunctionStmt(Function& stmt) override
+  {
+    unsupported();
+    return Completion();
+  }
+
+  Completion visitBreakStmt(Break& stmt) override
+  {
+    a.jump(loop->end);
+    return Completion();
+  }
+
+  Completion visitContinueStmt(Continue& stmt) override
+  {
+    a.jump(loop->start);
+    return Completion();
+  }
+
+  Completion visitWhileStmt(While& stmt) override
+  {
+    Loop current = { loop };
+    loop = &current;
+    a.bind(current.start);
+    condition(stmt.getCondition(), false, current.end);
+    stmt.getBody().accept(*this);
+    a.jump(current.start);
+    a.bind(current.end);
+    loop = current.enclosing;
+    return Completion();
+  }
+
+  Completion visitIfStmt(If& stmt) override
+  {
+    Label otherwise, end;
+    condition(stmt.getCondition(), false, otherwise);
+    stmt.getThen().accept(*this);
+    if (stmt.hasElse())
+      a.jump(end);
+    a.bind(otherwise);
+    if (stmt.hasElse())
+      stmt.getElse().accept(*this);
+    a.bind(end);
+    return Completion();
+  }
+
+  Completion visitExpressionStmt(Expression& stmt) override
+  {
+    compile(stmt.getExpr());
+    return Completion();
+  }
+
+  Completion visitPrintStmt(Print& stmt) override
+  {
+    unsupported();
+    return Completion();
+  }
+
+  Completion visitVarStmt(Var& stmt) override
+  {
+    const VarDecl& decl = stmt.getDecl();
+    if (decl.global || decl.boxed || !stmt.hasInitializer())
+    {
+      unsupported();
+      return Completion();
+    }
+    compile(stmt.getInitializer());
+    a.storeLocal(decl.slot, 0);
+    return Completion();
+  }
+
+  Completion visitBlockStmt(Block& stmt) override
+  {
+    for (const auto& statement : stmt.getStatements())
+    {
+      if (statement != nullptr)
+        statement->accept(*this);
+    }
+    return Completion();
+  }
+
+  Value visitCallExpr(Call& expr) override
+  {
+    pushCall(expr);
+    if (!supported)
+      return Value();
+    popCall(expr.getArgs().size());
+    callNative();
+    return Value();
+  }
+
+  /* and/or only work as conditions, as values they can be bools */
+  Value visitLogicalExpr(Logical& expr) override
+  {
+    unsupported();
+    return Value();
+  }
+
+  Value visitBinaryExpr(Binary& expr) override
+  {
+    uint8_t op;
+    switch (expr.getOp().type)
+    {
+    case PLUS:  op = SSE_ADD; break;
+    case MINUS: op = SSE_SUB; break;
+    case STAR:  op = SSE_MUL; break;
+    case SLASH: op = SSE_DIV; break;
+    default:
+      unsupported();
+      return Value();
+    }
+
+    operands(expr);
+    if (op == SSE_DIV)
+    {
+      /* leave dividing by zero to the interpreter, it knows the error */
+      Label ok;
+      a.sse(0x66, SSE_XORPD, 2, 2);
+      a.sse(0x66, SSE_UCOMISD, 1, 2);
+      a.jump(CC_P, ok);
+      a.jump(CC_E, bail);
+      a.bind(ok);
+    }
+    a.sse(0xf2, op, 0, 1);
+    return Value();
+  }
+
+  Value visitGroupingExpr(Grouping& expr) override
+  {
+    compile(expr.getExpr());
+    return Value();
+  }
+
+  Value visitLiteralExpr(Literal& expr) override
+  {
+    if (!expr.getLit().isNumber())
+      unsupported();
+    else
+      a.loadNumber(0, expr.getLit().asNumber());
+    return Value();
+  }
+
+  Value visitUnaryExpr(Unary& expr) override
+  {
+    if (expr.getOp().type != MINUS)
+    {
+      unsupported();
+      return Value();
+    }
+    compile(expr.getRight());
+    a.movRax(0x8000000000000000);
+    a.movqXmmRax(1);
+    a.sse(0x66, SSE_XORPD, 0, 1);
+    return Value();
+  }
+
+  Value visitVariableExpr(Variable& expr) override
+  {
+    if (expr.getRef().kind != VAR_LOCAL)
+      unsupported();
+    else
+      a.loadLocal(0, expr.getRef().index);
+    return Value();
+  }
+
+  Value visitAssignExpr(Assign& expr) override
+  {
+    if (expr.getRef().kind != VAR_LOCAL)
+    {
+      unsupported();
+      return Value();
+    }
+    compile(expr.getValue());
+    a.storeLocal(expr.getRef().index, 0);
+    return Value();
+  }
+
+  Value visitLambdaExpr(Lambda& expr) override
+  {
+    unsupported();
+    return Value();
+  }
+
+  FunctionInfo& info;
+  bool supported = true;
+  /* 8 byte temporaries on the machine stack right now */
+  int pushed = 0;
+  /* args of every call in the body, for the frame stack estimate */
+  int argSlots = 0;
+  Label body, bail, exit;
+  Loop* loop = nullptr;
+};
+
+}
+
+Jit::Jit(Environment& globals)
+  : globals(globals)
+{}
+
+Jit::~Jit()
+{
+  for (const auto& region : regions)
+    munmap(region.first, region.second);
+}
+
+bool Jit::isSupported()
+{
+  return true;
+}
+
+void* Jit::compile(FunctionInfo& info)
+{
+  if (info.jit.tried)
+    return info.jit.code;
+  info.jit.tried = true;
+
+  JitCompiler compiler(info);
+  if (!compiler.compile())
+    return nullptr;
+
+  /* never writable and executable at the same time */
+  const std::vector<uint8_t>& code = compiler.a.code;
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t size = (code.size() + page - 1) / page * page;
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+    return nullptr;
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+  {
+    munmap(memory, size);
+    return nullptr;
+  }
+  regions.push_back({ memory, size });
+  stats.jitFunctions++;
+  info.jit.code = memory;
+  return memory;
+}
+
+bool Jit::call(Callable* function, const Value* args, int callDepth, int64_t stackLeft, Value& result)
+{
+  FunctionInfo& info = function->getInfo();
+  void* code = compile(info);
+  if (code == nullptr)
+    return false;
+
+  double numbers[MAX_ARITY] = {};
+  for (int i = 0; i < info.getArity(); i++)
+  {
+    if (!args[i].isNumber())
+      return false;
+    numbers[i] = args[i].asNumber();
+  }
+
+  state = { 0, Engine::MAX_CALL_DEPTH - callDepth, 0, stackLeft, 0 };
+  running = this;
+  double number = ((NativeFunction)code)(numbers[0], numbers[1], numbers[2], numbers[3], numbers[4], numbers[5]);
+  if (state.bailedOut)
+  {
+    stats.jitBailouts++;
+    if (++info.jit.bailouts == MAX_BAILOUTS)
+      info.jit.code = nullptr;
+    return false;
+  }
+  stats.nativeCalls++;
+  result = Value(number);
+  return true;
+}
+
+#else
+
+/* no native code on this platform, everything runs in the interpreter */
+Jit::Jit(Environment& globals)
+  : globals(globals)
+{}
+
+Jit::~Jit() {}
+
+bool Jit::isSupported()
+{
+  return false;
+}
+
+void* Jit::compile(FunctionInfo& info)
+{
+  return nullptr;
+}
+
+bool Jit::call(Callable* function, const Value* args, int callDepth, int64_t stackLeft, Value& result)
+{
+  return false;
+}
+
+#endif
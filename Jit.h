@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Stmt.h"
+#include "Environment.h"
+#include <cstdint>
+#include <vector>
+
+class Callable;
+
+enum JitMode
+{
+	JIT_OFF,
+	JIT_ON,
+	JIT_VERIFY
+};
+
+/*
+ * Baseline JIT for the tree walker, Linux x86-64 only. A function gets
+ * native code the first time it's called if all it does is arithmetic
+ * on its own params and locals: number literals, + - * / and unary -,
+ * comparisons, and/or/! in conditions, var, assignment, if, while,
+ * break/continue, return and calls to global functions that are native
+ * too. Locals then live in the machine frame as plain doubles.
+ *
+ * Code like that can't have side effects, so whenever the native code
+ * hits something it doesn't handle (an argument that isn't a number,
+ * dividing by zero, a callee without native code, running off the end
+ * of the body, recursing too deep) it just gives up and the interpreter
+ * runs the call from the start, errors included. A function that keeps
+ * giving up loses its native code.
+ *
+ * --jit=off turns it off, --jit=verify runs every native call in the
+ * interpreter too and reports on stderr when the results differ.
+ */
+class Jit
+{
+public:
+	Jit(Environment& globals);
+	~Jit();
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+
+	/* false if this build can't make native code */
+	static bool isSupported();
+	/*
+	 * runs a call with its args already in the frame. callDepth and
+	 * stackLeft are the interpreter's, native code gives up before it
+	 * would have overflowed. false means nothing happened and the
+	 * interpreter has to make the call
+	 */
+	bool call(Callable* function, const Value* args, int callDepth, int64_t stackLeft, Value& result);
+	/* native code for info, compiled on first use, null if it can't be */
+	void* compile(FunctionInfo& info);
+
+	/* a function's native code is dropped after giving up this often */
+	static constexpr int MAX_BAILOUTS = 16;
+	/* params go in xmm0..xmm5 */
+	static constexpr int MAX_ARITY = 6;
+
+	Environment& globals;
+private:
+	/* mmap'd code, unmapped with the Jit */
+	std::vector<std::pair<void*, size_t>> regions;
+};
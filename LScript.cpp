@@ -1,53 +1,142 @@
 ﻿#include <iostream>
-#include <fstream>
-#include <sstream>
+#include <chrono>
 
 #ifdef __EMSCRIPTEN__
   #include <emscripten.h>
 #endif
 
-#include "Parser.h"
-#include "Lexer.h"
+#include "FrontEnd.h"
+#include "ProgramCache.h"
 #include "Interpreter.h"
+#include "VM.h"
+#include "ClosureEngine.h"
+#include "Resolver.h"
+#include "Optimizer.h"
+#include "Stats.h"
+#include "Heap.h"
+#include "Memory.h"
 
-Interpreter interpreter;
+Interpreter treeWalker;
+VM vm;
+ClosureEngine closureEngine;
+/* what run() hands programs to, --engine picks it */
+Engine* engine = &treeWalker;
+/* --optimize runs the Optimizer, --dump-opt too and reports what it changed */
+bool optimize = false;
+bool dumpOptimizations = false;
+/* --parse-threads, 0 for one per core */
+int parseThreads = 1;
+/* --cache saves scripts' ASTs next to them, --cache-dir in a directory, see ProgramCache.h */
+bool useCache = false;
+std::string cacheDir;
 
-static void run(std::string str)
+static uint64_t nanosSince(std::chrono::steady_clock::time_point start)
 {
-  Lexer lexer = Lexer(str);
-  std::vector<Token> tokens = lexer.lexAll();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* program.source is filled in, false if the lexer or the parser reported errors */
+static bool compile(Program& program)
+{
+  auto start = std::chrono::steady_clock::now();
+  FrontEnd frontEnd(program, parseThreads);
+  frontEnd.lex();
+  /* every piece ends in its own EOF, the source has one */
+  for (const auto& tokens : program.tokens)
+    stats.tokens += tokens.size();
+  stats.tokens -= program.tokens.size() - 1;
+  stats.sourceBytes += program.source.size();
+  stats.lexNanos += nanosSince(start);
 #ifdef LDEBUG
-  for (const auto& token : tokens)
+  for (const auto& tokens : program.tokens)
   {
+    for (const auto& token : tokens)
        std::cout << token << std::endl;
   }
 #endif
-  Parser parser = Parser(tokens);
-  std::list<std::unique_ptr<Stmt>> stmt_list = parser.parse();
-  if (!stmt_list.empty())
-    interpreter.interpret(std::move(stmt_list));
+  start = std::chrono::steady_clock::now();
+  {
+    Arena::Scope scope(program.arena);
+    frontEnd.parse();
+    if (optimize)
+      Optimizer(dumpOptimizations ? &std::cerr : nullptr).optimize(program.statements);
+  }
+  stats.parseNanos += nanosSince(start);
+  return !frontEnd.hadErrors();
+}
+
+/* resolves and runs what compile() or the program cache made, what has errors was left out */
+static void execute(std::unique_ptr<Program> program)
+{
+  stats.astNodes += program->arena.getAllocations();
+  stats.astBytes += program->arena.getUsed();
+
+  auto start = std::chrono::steady_clock::now();
+  Resolver resolver(engine->getGlobals());
+  bool resolved = !program->statements.empty() && resolver.resolve(program->statements);
+  stats.resolveNanos += nanosSince(start);
+
+  start = std::chrono::steady_clock::now();
+  if (resolved)
+    engine->interpret(std::move(program), resolver.getSlotCount());
+  stats.runNanos += nanosSince(start);
+}
+
+static void run(std::unique_ptr<Program> program)
+{
+  compile(*program);
+  execute(std::move(program));
+}
+
+static void run(std::string str)
+{
+  auto program = std::make_unique<Program>();
+  program->source.assign(std::move(str));
+  run(std::move(program));
 }
 
 #ifdef __EMSCRIPTEN__
 extern "C"
 {
+  /* returns everything the script printed */
   EMSCRIPTEN_KEEPALIVE
-  void crun(const char *c_str)
+  const char *crun(const char *c_str)
   {
+    static BufferSink buffer;
+    buffer.clear();
+    engine->setOutput(&buffer);
     run(c_str);
+    return buffer.getContents().c_str();
   }
 }
 #endif
 
 static int runFile(char *script_name)
 {
-	std::ifstream fileStream(script_name);
-	std::ostringstream oss;
-	oss << fileStream.rdbuf();
-	std::string fileStr = oss.str();
-	if (fileStr.empty())
+	/* lexed straight from the mapped file, see Source.h */
+	auto start = std::chrono::steady_clock::now();
+	auto program = std::make_unique<Program>();
+	if (!program->source.load(script_name) || program->source.size() == 0)
 		return 1;
-	run(fileStr);
+	stats.loadNanos += nanosSince(start);
+	/* --dump-opt has to see the Optimizer run */
+	if (!useCache || dumpOptimizations)
+		run(std::move(program));
+	else
+	{
+		start = std::chrono::steady_clock::now();
+		ProgramCache cache(cacheDir, script_name, program->source.view(), optimize);
+		bool cached = cache.load(*program);
+		stats.cacheNanos += nanosSince(start);
+		if (!cached && compile(*program))
+		{
+			start = std::chrono::steady_clock::now();
+			cache.store(*program);
+			stats.cacheNanos += nanosSince(start);
+		}
+		execute(std::move(program));
+	}
+	engine->getOutput().flush();
 	return 0;
 }
 
@@ -57,27 +146,185 @@ static int runPrompt()
 	{
 		std::string line;
 		std::cout << "> ";
-		std::getline(std::cin, line);
+		if (!std::getline(std::cin, line))
+			break;
 		if (!line.empty())
 			run(line);
+		engine->getOutput().flush();
 	}
 	return 0;
 }
 
+/* a count for a --flag=<n>, -1 if it isn't one */
+static int parseCount(const std::string& str)
+{
+	if (str.empty() || str.size() > 6 || str.find_first_not_of("0123456789") != std::string::npos)
+		return -1;
+	return std::stoi(str);
+}
+
+/* bytes for --mem-limit, with an optional k or m suffix, 0 if it isn't a size */
+static size_t parseBytes(std::string str)
+{
+	size_t unit = 1;
+	if (!str.empty() && (str.back() == 'k' || str.back() == 'K'))
+		unit = 1024;
+	else if (!str.empty() && (str.back() == 'm' || str.back() == 'M'))
+		unit = 1024 * 1024;
+	if (unit != 1)
+		str.pop_back();
+	if (str.empty() || str.size() > 12 || str.find_first_not_of("0123456789") != std::string::npos)
+		return 0;
+	return std::stoull(str) * unit;
+}
+
+static int usage()
+{
+	std::cerr << "Usage: LScript [options] [script]" << std::endl;
+	std::cerr << "  --flush=line|size|explicit  when print output is flushed (default: size, line for the REPL)" << std::endl;
+	std::cerr << "  --output=<file>             write print output to a file instead of stdout" << std::endl;
+	std::cerr << "  --engine=tree|vm|closure    run on the tree walker (default), the bytecode VM or compiled closures" << std::endl;
+	std::cerr << "  --jit=on|off|verify         native code for numeric functions in the tree walker (default: on),\n"
+	             "                              verify runs them in the interpreter too and reports differences" << std::endl;
+	std::cerr << "  --inline-size=<n>           inline calls to global functions of one statement of up to n nodes\n"
+	             "                              in the tree walker (default: 16, 0 turns it off)" << std::endl;
+	std::cerr << "  --inline-depth=<n>          how deep inlined calls nest inside each other (default: 4)" << std::endl;
+	std::cerr << "  --gc-threshold=<n>          closures and cells made before the first cycle collection (default: 16384)" << std::endl;
+	std::cerr << "  --gc-growth=<percent>       next collection once what survived grew to this much, over 100 (default: 200)" << std::endl;
+	std::cerr << "  --gc-stress                 collect every time a closure or cell is made" << std::endl;
+	std::cerr << "  --mem-limit=<bytes>[k|m]    stop a run with an error once strings, closures and frames take more" << std::endl;
+	std::cerr << "  --parse-threads=<n>         lex and parse big scripts on n threads, 0 for one per core (default: 1)" << std::endl;
+	std::cerr << "  --cache                     save the parsed script next to it (script.lsc) and skip parsing\n"
+	             "                              while the script doesn't change" << std::endl;
+	std::cerr << "  --cache-dir=<dir>           --cache, with the saved scripts in dir" << std::endl;
+	std::cerr << "  --optimize                  fold constants and drop dead if branches before running" << std::endl;
+	std::cerr << "  --dump-opt                  --optimize and print what it changed to stderr" << std::endl;
+	std::cerr << "  --stats                     print call and allocation counters to stderr when done" << std::endl;
+	return 1;
+}
+
 int main(int argc, char **argv)
 {
-	if (argc > 2)
+	char *script = nullptr;
+	std::string flush;
+	std::string outputPath;
+	std::string engineName;
+	std::string jitMode;
+	int inlineSize = 16;
+	int inlineDepth = 4;
+	int gcThreshold = Heap::DEFAULT_THRESHOLD;
+	int gcGrowth = Heap::DEFAULT_GROWTH;
+	bool showStats = false;
+	for (int i = 1; i < argc; i++)
 	{
-		std::cerr << "Usage: LScript [script]" << std::endl;
-		return 1;
+		std::string arg = argv[i];
+		if (arg.rfind("--flush=", 0) == 0)
+			flush = arg.substr(8);
+		else if (arg.rfind("--output=", 0) == 0)
+			outputPath = arg.substr(9);
+		else if (arg.rfind("--engine=", 0) == 0)
+			engineName = arg.substr(9);
+		else if (arg.rfind("--jit=", 0) == 0)
+			jitMode = arg.substr(6);
+		else if (arg.rfind("--inline-size=", 0) == 0)
+			inlineSize = parseCount(arg.substr(14));
+		else if (arg.rfind("--inline-depth=", 0) == 0)
+			inlineDepth = parseCount(arg.substr(15));
+		else if (arg.rfind("--gc-threshold=", 0) == 0)
+			gcThreshold = parseCount(arg.substr(15));
+		else if (arg.rfind("--gc-growth=", 0) == 0)
+			gcGrowth = parseCount(arg.substr(12));
+		else if (arg == "--gc-stress")
+			heap.setStress(true);
+		else if (arg.rfind("--mem-limit=", 0) == 0)
+		{
+			size_t limit = parseBytes(arg.substr(12));
+			if (limit == 0)
+				return usage();
+			memory.setLimit(limit);
+		}
+		else if (arg.rfind("--parse-threads=", 0) == 0)
+		{
+			parseThreads = parseCount(arg.substr(16));
+			if (parseThreads < 0)
+				return usage();
+		}
+		else if (arg == "--cache")
+			useCache = true;
+		else if (arg.rfind("--cache-dir=", 0) == 0)
+		{
+			useCache = true;
+			cacheDir = arg.substr(12);
+			if (cacheDir.empty())
+				return usage();
+		}
+		else if (arg == "--optimize")
+			optimize = true;
+		else if (arg == "--dump-opt")
+			optimize = dumpOptimizations = true;
+		else if (arg == "--stats")
+			showStats = true;
+		else if (arg.rfind("--", 0) == 0 || script != nullptr)
+			return usage();
+		else
+			script = argv[i];
+	}
+
+	if (engineName == "vm")
+		engine = &vm;
+	else if (engineName == "closure")
+		engine = &closureEngine;
+	else if (!engineName.empty() && engineName != "tree")
+		return usage();
+
+	if (jitMode == "off")
+		treeWalker.setJitMode(JIT_OFF);
+	else if (jitMode == "verify")
+		treeWalker.setJitMode(JIT_VERIFY);
+	else if (!jitMode.empty() && jitMode != "on")
+		return usage();
+
+	if (inlineSize < 0 || inlineDepth < 0)
+		return usage();
+	treeWalker.setInlineLimits(inlineSize, inlineDepth);
+
+	/* not growing past 100% would collect on every allocation once the heap is full of live objects */
+	if (gcThreshold < 1 || gcGrowth <= 100)
+		return usage();
+	heap.setLimits(gcThreshold, gcGrowth);
+
+	FlushPolicy policy = (script != nullptr) ? FLUSH_SIZE : FLUSH_LINE;
+	if (flush == "line")
+		policy = FLUSH_LINE;
+	else if (flush == "size")
+		policy = FLUSH_SIZE;
+	else if (flush == "explicit")
+		policy = FLUSH_EXPLICIT;
+	else if (!flush.empty())
+		return usage();
+
+	std::unique_ptr<FileSink> fileSink;
+	if (!outputPath.empty())
+	{
+		fileSink = std::make_unique<FileSink>(outputPath, policy);
+		if (!fileSink->isOpen())
+		{
+			std::cerr << "Could not open " << outputPath << std::endl;
+			return 1;
+		}
+		engine->setOutput(fileSink.get());
 	}
+	engine->getOutput().setPolicy(policy);
 
 #ifdef LDEBUG
-	std::string script;
+	std::string scriptName;
 	std::cout << "Run script: ";
-	std::cin >> script;
-	return runFile((char*)std::string("../scripts/" + script).c_str());
+	std::cin >> scriptName;
+	return runFile((char*)std::string("../scripts/" + scriptName).c_str());
 #else
-	return (argc == 2) ? runFile(argv[1]) : runPrompt();
+	int result = (script != nullptr) ? runFile(script) : runPrompt();
+	if (showStats)
+		printStats(std::cerr);
+	return result;
 #endif
 }
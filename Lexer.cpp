@@ -1,27 +1,63 @@
 #include "Lexer.h"
+#include "Scan.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <iostream>
+#include <limits>
 
-Lexer::Lexer(std::string src)
-  : src(src)
-{
-  keywords["and"] = AND;
-  keywords["class"] = CLASS;
-  keywords["else"] = ELSE;
-  keywords["false"] = FALSE;
-  keywords["for"] = FOR;
-  keywords["function"] = FUNC;
-  keywords["if"] = IF;
-  keywords["nil"] = NIL;
-  keywords["or"] = OR;
-  keywords["print"] = PRINT;
-  keywords["return"] = RETURN;
-  keywords["super"] = SUPER;
-  keywords["this"] = THIS;
-  keywords["true"] = TRUE;
-  keywords["var"] = VAR;
-  keywords["while"] = WHILE;
-  keywords["break"] = BREAK;
-  keywords["continue"] = CONTINUE;
+struct Keyword
+{
+  std::string_view name;
+  TokenType type;
+};
+
+static constexpr Keyword KEYWORDS[] = {
+  { "and", AND }, { "class", CLASS }, { "else", ELSE }, { "false", FALSE }, { "for", FOR },
+  { "function", FUNC }, { "if", IF }, { "nil", NIL }, { "or", OR }, { "print", PRINT },
+  { "return", RETURN }, { "super", SUPER }, { "this", THIS }, { "true", TRUE }, { "var", VAR },
+  { "while", WHILE }, { "break", BREAK }, { "continue", CONTINUE }
+};
+
+/*
+ * perfect hash of the keywords on their first and last letter and their
+ * length, an identifier is a keyword only if it's the one in its bucket
+ */
+static constexpr size_t keywordHash(std::string_view name)
+{
+  return ((unsigned char)name.front() + (unsigned char)name.back() * 7 + name.size() * 2) & 31;
+}
+
+static constexpr std::array<int, 32> keywordTable()
+{
+  std::array<int, 32> table{};
+  for (int& entry : table)
+    entry = -1;
+  for (int i = 0; i < (int)std::size(KEYWORDS); i++)
+    table[keywordHash(KEYWORDS[i].name)] = i;
+  return table;
+}
+
+static constexpr std::array<int, 32> KEYWORD_TABLE = keywordTable();
+
+static constexpr bool keywordsCollide()
+{
+  for (int i = 0; i < (int)std::size(KEYWORDS); i++)
+  {
+    if (KEYWORD_TABLE[keywordHash(KEYWORDS[i].name)] != i)
+      return true;
+  }
+  return false;
+}
+
+static_assert(!keywordsCollide(), "two keywords hash to the same bucket, change keywordHash");
+
+
+/* tokens are about 4 chars on average, this saves most of the regrowing */
+Lexer::Lexer(std::string_view src, int line, LocalSymbols* symbols, std::ostream& errors)
+  : src(src), line(line), symbols(symbols), errors(errors)
+{
+  tokens.reserve(src.size() / 4 + 1);
 }
 
 bool Lexer::isAtEnd()
@@ -31,14 +67,14 @@ bool Lexer::isAtEnd()
 
 char Lexer::advance()
 {
-  return src.at(curr++);
+  return src[curr++];
 }
 
 bool Lexer::match(char c)
 {
   if (isAtEnd())
     return false;
-  if (src.at(curr) != c)
+  if (src[curr] != c)
     return false;
   curr++;
   return true;
@@ -48,24 +84,24 @@ char Lexer::peek()
 {
   if (isAtEnd())
     return '\0';
-  return src.at(curr);
+  return src[curr];
 }
 
 char Lexer::peekNext()
 {
   if (curr + 1 >= src.length())
     return '\0';
-  return src.at(curr + 1);
+  return src[curr + 1];
 }
 
-void Lexer::addToken(TokenType type, std::any lit)
+void Lexer::addToken(TokenType type, std::variant<std::monostate, double, Symbol> lit)
 {
-  tokens.push_back(Token(type, src.substr(start, curr - start), lit, line));
+  tokens.emplace_back(type, src.substr(start, curr - start), lit, line);
 }
 
 void Lexer::addToken(TokenType type)
 {
-  addToken(type, nullptr);
+  tokens.emplace_back(type, src.substr(start, curr - start), line);
 }
 
 bool Lexer::isDigit(char c)
@@ -80,11 +116,6 @@ bool Lexer::isAlpha(char c)
           c == '_';
 }
 
-bool Lexer::isAlphaNum(char c)
-{
-  return isAlpha(c) || isDigit(c);
-}
-
 void Lexer::number()
 {
   while (isDigit(peek()))
@@ -98,42 +129,43 @@ void Lexer::number()
       advance();
   }
 
-  addToken(NUMBER, std::stod(src.substr(start, curr - start)));
+  double value = 0;
+  const char* first = src.data() + start;
+  const char* last = src.data() + curr;
+  /* from_chars leaves value alone when it doesn't fit, a literal has no sign */
+  if (std::from_chars(first, last, value).ec == std::errc::result_out_of_range)
+  {
+    /* too big if there's a digit other than 0 before the '.', too small otherwise */
+    const char* dot = std::find(first, last, '.');
+    bool big = std::find_if(first, dot, [](char c) { return c != '0'; }) != dot;
+    value = big ? std::numeric_limits<double>::infinity() : 0;
+  }
+  addToken(NUMBER, value);
 }
 
 void Lexer::string()
 {
-  while (peek() != '"' && !isAtEnd())
-  {
-    if (peek() == '\n')
-      line++;
-    advance();
-  }
+  curr = findQuote(src.data() + curr, src.data() + src.size(), line) - src.data();
 
   if (isAtEnd())
   {
-    std::cerr << "Unterminated string" << std::endl;
+    error("Unterminated string");
     return;
   }
 
   /* current is at the quote so consume quote */
   advance();
-  /* trim surrounding quotes */
-  addToken(STRING, src.substr(start + 1, (curr - 1) - (start + 1)));
+  /* the value is the lexeme without the quotes, see Token::string */
+  addToken(STRING);
 }
 
 void Lexer::ctypeComment()
 {
-  while (!(peek() == '*' && peekNext() == '/') && !isAtEnd())
-  {
-    if (peek() == '\n')
-      line++;
-    advance();
-  }
+  curr = findCommentEnd(src.data() + curr, src.data() + src.size(), line) - src.data();
 
   if (isAtEnd())
   {
-    std::cerr << "You didn't close your comment.. You fucked up BIG ONE" << std::endl;
+    error("You didn't close your comment.. You fucked up BIG ONE");
     return;
   }
 
@@ -144,13 +176,19 @@ void Lexer::ctypeComment()
 
 void Lexer::identifier()
 {
-  while (isAlphaNum(peek()))
-    advance();
-  std::string str = src.substr(start, curr - start);
-  if (keywords.find(str) == keywords.end())
-    addToken(IDENTIFIER);
+  curr = skipIdentifier(src.data() + curr, src.data() + src.size()) - src.data();
+  std::string_view text = src.substr(start, curr - start);
+  int keyword = KEYWORD_TABLE[keywordHash(text)];
+  if (keyword >= 0 && KEYWORDS[keyword].name == text)
+    addToken(KEYWORDS[keyword].type);
   else
-    addToken(keywords.find(str)->second);
+    addToken(IDENTIFIER, symbols != nullptr ? symbols->intern(text) : Symbols::intern(text));
+}
+
+void Lexer::error(const std::string& message)
+{
+  errors << message << std::endl;
+  failed = true;
 }
 
 void Lexer::lex()
@@ -182,8 +220,7 @@ void Lexer::lex()
     case '/':
       if (match('/'))
       {
-        while (peek() != '\n' && !isAtEnd())
-          advance();
+        curr = findNewline(src.data() + curr, src.data() + src.size()) - src.data();
       }
       else if (match('*'))
       {
@@ -194,14 +231,6 @@ void Lexer::lex()
         addToken(SLASH);
       }
       break;
-    case ' ':
-    case '\r':
-    case '\t':
-      // Ignore whitespace.
-      break;
-    case '\n':
-      line++;
-      break;
     case '"':
       string();
       break;
@@ -211,18 +240,23 @@ void Lexer::lex()
       else if (isAlpha(c))
         identifier();
       else
-        std::cerr << "ERRRRRRR!!! LEXER ERROR!!!" << std::endl;
+        error("ERRRRRRR!!! LEXER ERROR!!!");
       break;
   }
 }
 
-std::vector<Token>& Lexer::lexAll()
+std::vector<Token> Lexer::lexAll()
 {
-  while (!isAtEnd())
+  const char* end = src.data() + src.size();
+  for (;;)
   {
+    /* whitespace never makes a token, lex() only ever starts on something else */
+    curr = skipSpace(src.data() + curr, end, line) - src.data();
+    if (isAtEnd())
+      break;
     start = curr;
     lex();
   }
-  tokens.push_back(Token(_EOF_, "", 0, line));
-  return tokens;
+  tokens.emplace_back(_EOF_, "", line);
+  return std::move(tokens);
 }
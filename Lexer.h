@@ -1,21 +1,30 @@
 #pragma once
 
 #include "Token.h"
+#include <iostream>
+#include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
 
 class Lexer
 {
 private:
-  std::string src;
+  /* tokens point into src, whoever has the tokens keeps it alive */
+  std::string_view src;
   std::vector<Token> tokens;
-  std::unordered_map<std::string, TokenType> keywords;
-  int start = 0;
-  int curr = 0;
-  int line = 0;
+  size_t start = 0;
+  size_t curr = 0;
+  int line;
+  /* null to intern in Symbols directly, see LocalSymbols */
+  LocalSymbols* symbols;
+  std::ostream& errors;
+  bool failed = false;
 public:
-  Lexer(std::string src);
-  std::vector<Token>& lexAll();
+  /* line is the one src starts on, the front end lexes pieces of a script (FrontEnd.h) */
+  Lexer(std::string_view src, int line = 0, LocalSymbols* symbols = nullptr, std::ostream& errors = std::cerr);
+  /* hands over the tokens, the Parser reads them where they are */
+  std::vector<Token> lexAll();
+  bool hadErrors() const { return failed; }
 private:
   void lex();
   bool isAtEnd();
@@ -23,13 +32,13 @@ private:
   bool match(char c);
   char peek();
   char peekNext();
-  void addToken(TokenType type, std::any lit);
+  void addToken(TokenType type, std::variant<std::monostate, double, Symbol> lit);
   void addToken(TokenType type);
   void ctypeComment();
   bool isDigit(char c);
   bool isAlpha(char c);
-  bool isAlphaNum(char c);
   void string();
   void number();
   void identifier();
+  void error(const std::string& message);
 };
\ No newline at end of file
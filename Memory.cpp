@@ -0,0 +1,17 @@
+#include "Memory.h"
+
+/* constant initialized and trivially destroyed, objects freed while statics go away still count */
+thread_local constinit Memory memory;
+
+void Memory::beginRun()
+{
+  if (limit != 0)
+    budget = limit;
+}
+
+void Memory::endRun()
+{
+  budget = SIZE_MAX;
+  used -= frames;
+  frames = 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* thrown by Memory::charge, the engines report it like a runtime error */
+struct MemoryLimitError
+{
+  size_t limit;
+};
+
+/*
+ * Counts the bytes a script holds on to: strings (the object and its
+ * chars), closures with their upvalues, cells, and the frames of the
+ * calls running right now. --mem-limit makes that a hard limit for
+ * embedders that run scripts they don't trust. Going over it aborts the
+ * run with a runtime error instead of taking the whole process down, the
+ * REPL and the host keep going.
+ *
+ * Only counts against the limit while an engine runs a program, string
+ * literals the Parser makes never fail. The frame stacks themselves are
+ * allocated once up front, what counts is the part calls use.
+ */
+class Memory
+{
+public:
+  /* throws MemoryLimitError and counts nothing if bytes don't fit */
+  void charge(size_t bytes)
+  {
+    if (used + bytes > budget)
+      throw MemoryLimitError{ limit };
+    used += bytes;
+    if (used > peak)
+      peak = used;
+  }
+
+  /*
+   * ropes share their parts, s = s + s doubles the length for a few bytes.
+   * one longer than what's left could never be flattened
+   */
+  void checkLength(size_t length) const
+  {
+    if (length > budget - used)
+      throw MemoryLimitError{ limit };
+  }
+
+  void release(size_t bytes)
+  {
+    used -= bytes;
+  }
+
+  /* whether a frame of bytes fits, the engines throw with the call's token if not */
+  bool fitsFrame(size_t bytes) const
+  {
+    return used + bytes <= budget;
+  }
+
+  /* fitsFrame() was checked first */
+  void pushFrame(size_t bytes)
+  {
+    frames += bytes;
+    used += bytes;
+    if (used > peak)
+      peak = used;
+  }
+
+  void popFrame(size_t bytes)
+  {
+    frames -= bytes;
+    used -= bytes;
+  }
+
+  /* around Engine::interpret, a run aborted by an error never pops its frames */
+  void beginRun();
+  void endRun();
+
+  /* takes over what another thread counted, objects it made are freed here */
+  void add(const Memory& other)
+  {
+    used += other.used;
+    if (used > peak)
+      peak = used;
+  }
+
+  void setLimit(size_t limit)
+  {
+    this->limit = limit;
+  }
+
+  size_t getLimit() const
+  {
+    return limit;
+  }
+
+  size_t getUsed() const
+  {
+    return used;
+  }
+
+  /* highest getUsed() since the process started */
+  size_t getPeak() const
+  {
+    return peak;
+  }
+private:
+  /* frames included */
+  size_t used = 0;
+  size_t frames = 0;
+  size_t peak = 0;
+  /* 0 for no limit */
+  size_t limit = 0;
+  /* what charge() checks against, the limit while a run is going and no limit otherwise */
+  size_t budget = SIZE_MAX;
+};
+
+/* one per thread like Stats, only the main thread's has a limit */
+extern thread_local constinit Memory memory;
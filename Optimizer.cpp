@@ -0,0 +1,316 @@
+#include "Optimizer.h"
+#include "Engine.h"
+
+/* a literal the way it would be written in the script */
+static std::string describe(const Value& value)
+{
+  switch (value.getType())
+  {
+  case VAL_NIL:    return "nil";
+  case VAL_BOOL:   return value.asBool() ? "true" : "false";
+  case VAL_NUMBER: return numberToString(value.asNumber());
+  case VAL_STRING: return "\"" + value.asString()->getChars() + "\"";
+  default:         return "?";
+  }
+}
+
+/* the expression always gives a bool or fails */
+static bool isBool(Expr& expr)
+{
+  if (Literal* literal = dynamic_cast<Literal*>(&expr))
+    return literal->getLit().isBool();
+  if (Unary* unary = dynamic_cast<Unary*>(&expr))
+    return unary->getOp().type == BANG;
+  if (Binary* binary = dynamic_cast<Binary*>(&expr))
+  {
+    switch (binary->getOp().type)
+    {
+    case BANG_EQUAL: case EQUAL_EQUAL: case GREATER: case GREATER_EQUAL: case LESS: case LESS_EQUAL:
+      return true;
+    default:
+      return false;
+    }
+  }
+  return false;
+}
+
+/* the expression always gives a number or fails, + doesn't count because of strings */
+static bool isNumber(Expr& expr)
+{
+  if (Literal* literal = dynamic_cast<Literal*>(&expr))
+    return literal->getLit().isNumber();
+  if (Unary* unary = dynamic_cast<Unary*>(&expr))
+    return unary->getOp().type == MINUS;
+  if (Binary* binary = dynamic_cast<Binary*>(&expr))
+  {
+    TokenType op = binary->getOp().type;
+    return op == MINUS || op == STAR || op == SLASH;
+  }
+  return false;
+}
+
+void Optimizer::optimize(std::list<std::unique_ptr<Stmt>>& statements)
+{
+  for (auto& statement : statements)
+  {
+    if (statement != nullptr)
+      optimize(statement);
+  }
+  if (dump != nullptr && groupings > 0)
+    *dump << "OPTIMIZER: removed " << groupings << " grouping(s)" << std::endl;
+  groupings = 0;
+}
+
+void Optimizer::optimize(std::vector<std::unique_ptr<Stmt>>& statements)
+{
+  for (auto& statement : statements)
+  {
+    if (statement != nullptr)
+      optimize(statement);
+  }
+}
+
+void Optimizer::optimize(std::unique_ptr<Stmt>& stmt)
+{
+  stmt->accept(*this);
+  if (stmtReplacement != nullptr)
+    stmt = std::move(stmtReplacement);
+}
+
+void Optimizer::optimize(std::unique_ptr<Expr>& expr)
+{
+  expr->accept(*this);
+  if (exprReplacement != nullptr)
+    expr = std::move(exprReplacement);
+}
+
+void Optimizer::replaceWith(Value value)
+{
+  exprReplacement = std::make_unique<Literal>(std::move(value));
+}
+
+void Optimizer::report(const Token& token, const std::string& what)
+{
+  if (dump != nullptr)
+    *dump << "OPTIMIZER: [" << token.line << "] " << what << std::endl;
+}
+
+Completion Optimizer::visitReturnStmt(Return& stmt)
+{
+  optimize(stmt.value);
+  return Completion();
+}
+
+Completion Optimizer::visitFunctionStmt(Function& stmt)
+{
+  optimize(stmt.getInfo().body);
+  return Completion();
+}
+
+Completion Optimizer::visitBreakStmt(Break& stmt)
+{
+  return Completion();
+}
+
+Completion Optimizer::visitContinueStmt(Continue& stmt)
+{
+  return Completion();
+}
+
+Completion Optimizer::visitWhileStmt(While& stmt)
+{
+  optimize(stmt.condition);
+  optimize(stmt.body);
+  return Completion();
+}
+
+Completion Optimizer::visitIfStmt(If& stmt)
+{
+  optimize(stmt.condition);
+  optimize(stmt.thenBranch);
+  if (stmt.elseBranch != nullptr)
+    optimize(stmt.elseBranch);
+
+  Literal* literal = dynamic_cast<Literal*>(stmt.condition.get());
+  if (literal == nullptr)
+    return Completion();
+
+  /* a branch is never a declaration, so it can take the If's place without changing scopes */
+  std::string condition = "if (" + describe(literal->getLit()) + ")";
+  if (isTruthy(literal->getLit()))
+  {
+    report(stmt.getKeyword(), condition + " => then branch");
+    stmtReplacement = std::move(stmt.thenBranch);
+  }
+  else if (stmt.elseBranch != nullptr)
+  {
+    report(stmt.getKeyword(), condition + " => else branch");
+    stmtReplacement = std::move(stmt.elseBranch);
+  }
+  else
+  {
+    report(stmt.getKeyword(), condition + " => removed");
+    stmtReplacement = std::make_unique<Block>(std::vector<std::unique_ptr<Stmt>>());
+  }
+  return Completion();
+}
+
+Completion Optimizer::visitExpressionStmt(Expression& stmt)
+{
+  optimize(stmt.expression);
+  return Completion();
+}
+
+Completion Optimizer::visitPrintStmt(Print& stmt)
+{
+  optimize(stmt.expression);
+  return Completion();
+}
+
+Completion Optimizer::visitVarStmt(Var& stmt)
+{
+  if (stmt.initializer != nullptr)
+    optimize(stmt.initializer);
+  return Completion();
+}
+
+Completion Optimizer::visitBlockStmt(Block& stmt)
+{
+  optimize(stmt.statements);
+  return Completion();
+}
+
+Value Optimizer::visitCallExpr(Call& expr)
+{
+  optimize(expr.callee);
+  for (auto& arg : expr.args)
+    optimize(arg);
+  return Value();
+}
+
+Value Optimizer::visitLogicalExpr(Logical& expr)
+{
+  optimize(expr.left);
+  optimize(expr.right);
+
+  /* a literal on the left decides which side is the result */
+  Literal* literal = dynamic_cast<Literal*>(expr.left.get());
+  if (literal == nullptr)
+    return Value();
+  bool keepLeft = (expr.getOp().type == OR) == isTruthy(literal->getLit());
+  report(expr.getOp(), describe(literal->getLit()) + " " + std::string(expr.getOp().lexeme) + " ... => " +
+    (keepLeft ? describe(literal->getLit()) : "right side"));
+  exprReplacement = std::move(keepLeft ? expr.left : expr.right);
+  return Value();
+}
+
+Value Optimizer::visitBinaryExpr(Binary& expr)
+{
+  optimize(expr.left);
+  optimize(expr.right);
+
+  Literal* left = dynamic_cast<Literal*>(expr.left.get());
+  Literal* right = dynamic_cast<Literal*>(expr.right.get());
+  if (left != nullptr && right != nullptr)
+    fold(expr, left->getLit(), right->getLit());
+  return Value();
+}
+
+/* works out a Binary on two literals like the interpreter would, unless that would fail */
+void Optimizer::fold(Binary& expr, const Value& left, const Value& right)
+{
+  bool numbers = left.isNumber() && right.isNumber();
+  double l = numbers ? left.asNumber() : 0;
+  double r = numbers ? right.asNumber() : 0;
+
+  Value result;
+  switch (expr.getOp().type)
+  {
+  case BANG_EQUAL:    result = !isEqual(left, right); break;
+  case EQUAL_EQUAL:   result = isEqual(left, right); break;
+  case GREATER:       if (!numbers) return; result = l > r; break;
+  case GREATER_EQUAL: if (!numbers) return; result = l >= r; break;
+  case LESS:          if (!numbers) return; result = l < r; break;
+  case LESS_EQUAL:    if (!numbers) return; result = l <= r; break;
+  case MINUS:         if (!numbers) return; result = l - r; break;
+  case STAR:          if (!numbers) return; result = l * r; break;
+  case SLASH:
+    /* dividing by zero stays in so it fails on its line at runtime */
+    if (!numbers || r == 0)
+      return;
+    result = l / r;
+    break;
+  case PLUS:
+    if (!numbers && !(left.isString() && (right.isString() || right.isNumber())) &&
+        !(left.isNumber() && right.isString()))
+      return;
+    result = addValues(expr.getOp(), left, right);
+    break;
+  default:
+    return;
+  }
+
+  report(expr.getOp(), describe(left) + " " + std::string(expr.getOp().lexeme) + " " + describe(right) + " => " + describe(result));
+  replaceWith(std::move(result));
+}
+
+Value Optimizer::visitGroupingExpr(Grouping& expr)
+{
+  optimize(expr.expression);
+  groupings++;
+  exprReplacement = std::move(expr.expression);
+  return Value();
+}
+
+Value Optimizer::visitLiteralExpr(Literal& expr)
+{
+  return Value();
+}
+
+Value Optimizer::visitUnaryExpr(Unary& expr)
+{
+  optimize(expr.right);
+  TokenType op = expr.getOp().type;
+
+  if (Literal* literal = dynamic_cast<Literal*>(expr.right.get()))
+  {
+    const Value& operand = literal->getLit();
+    if (op == BANG)
+    {
+      report(expr.getOp(), "!" + describe(operand) + " => " + describe(!isTruthy(operand)));
+      replaceWith(!isTruthy(operand));
+    }
+    else if (operand.isNumber())
+    {
+      report(expr.getOp(), "-" + describe(operand) + " => " + describe(-operand.asNumber()));
+      replaceWith(-operand.asNumber());
+    }
+    return Value();
+  }
+
+  /* !!x is x if x is a bool already, - -x is x if x is a number */
+  Unary* inner = dynamic_cast<Unary*>(expr.right.get());
+  if (inner != nullptr && inner->getOp().type == op && (op == BANG ? isBool(*inner->right) : isNumber(*inner->right)))
+  {
+    report(expr.getOp(), "removed " + std::string(expr.getOp().lexeme) + std::string(inner->getOp().lexeme));
+    exprReplacement = std::move(inner->right);
+  }
+  return Value();
+}
+
+Value Optimizer::visitVariableExpr(Variable& expr)
+{
+  return Value();
+}
+
+Value Optimizer::visitAssignExpr(Assign& expr)
+{
+  optimize(expr.value);
+  return Value();
+}
+
+Value Optimizer::visitLambdaExpr(Lambda& expr)
+{
+  optimize(expr.getInfo().body);
+  return Value();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Stmt.h"
+#include <list>
+#include <ostream>
+
+/*
+ * Optional pass over the AST between the Parser and the Resolver
+ * (--optimize). Folds operators whose operands are literals, drops the
+ * If branch a literal condition never takes, short-circuits and/or on a
+ * literal left side, unwraps Groupings and removes !!x and - -x when x
+ * already is a bool or a number. Nothing that would fail at runtime is
+ * folded, so 1 / 0 or "a" - 1 still fail on their own line.
+ *
+ * Nodes get replaced in their parent's unique_ptr, the nodes let this
+ * class at them as a friend. With a dump stream (--dump-opt) every
+ * change is written there.
+ */
+class Optimizer : public ExprVisitor<Value>, public StmtVisitor<Completion>
+{
+public:
+	Optimizer(std::ostream* dump = nullptr) : dump(dump) {}
+
+	void optimize(std::list<std::unique_ptr<Stmt>>& statements);
+private:
+	void optimize(std::vector<std::unique_ptr<Stmt>>& statements);
+	void optimize(std::unique_ptr<Stmt>& stmt);
+	void optimize(std::unique_ptr<Expr>& expr);
+	void fold(Binary& expr, const Value& left, const Value& right);
+	void replaceWith(Value value);
+	void report(const Token& token, const std::string& what);
+
+	Completion visitReturnStmt(Return& stmt) override;
+	Completion visitFunctionStmt(Function& stmt) override;
+	Completion visitBreakStmt(Break& stmt) override;
+	Completion visitContinueStmt(Continue& stmt) override;
+	Completion visitWhileStmt(While& stmt) override;
+	Completion visitIfStmt(If& stmt) override;
+	Completion visitExpressionStmt(Expression& stmt) override;
+	Completion visitPrintStmt(Print& stmt) override;
+	Completion visitVarStmt(Var& stmt) override;
+	Completion visitBlockStmt(Block& stmt) override;
+	Value visitCallExpr(Call& expr) override;
+	Value visitLogicalExpr(Logical& expr) override;
+	Value visitBinaryExpr(Binary& expr) override;
+	Value visitGroupingExpr(Grouping& expr) override;
+	Value visitLiteralExpr(Literal& expr) override;
+	Value visitUnaryExpr(Unary& expr) override;
+	Value visitVariableExpr(Variable& expr) override;
+	Value visitAssignExpr(Assign& expr) override;
+	Value visitLambdaExpr(Lambda& expr) override;
+private:
+	std::ostream* dump;
+	/* set by a visit when the node it visited should be swapped for this */
+	std::unique_ptr<Expr> exprReplacement;
+	std::unique_ptr<Stmt> stmtReplacement;
+	/* they have no token to report a line for, so only the count gets reported */
+	int groupings = 0;
+};
@@ -0,0 +1,114 @@
+#include "Output.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+void OutputSink::write(std::string_view str)
+{
+  buffer.append(str);
+  if (policy == FLUSH_SIZE && buffer.size() >= capacity)
+    flush();
+}
+
+void OutputSink::writeNumber(double number)
+{
+  char chars[32];
+  write(std::string_view(chars, formatNumber(number, chars, sizeof(chars))));
+}
+
+void OutputSink::endLine()
+{
+  buffer.push_back('\n');
+  if (policy == FLUSH_LINE || (policy == FLUSH_SIZE && buffer.size() >= capacity))
+    flush();
+}
+
+void OutputSink::flush()
+{
+  if (buffer.empty())
+    return;
+  writeOut(buffer.data(), buffer.size());
+  buffer.clear();
+}
+
+void StdoutSink::writeOut(const char* data, size_t size)
+{
+  std::fwrite(data, 1, size, stdout);
+  std::fflush(stdout);
+}
+
+FileSink::FileSink(const std::string& path, FlushPolicy policy)
+  : OutputSink(policy), file(std::fopen(path.c_str(), "wb"))
+{}
+
+FileSink::~FileSink()
+{
+  if (file == nullptr)
+    return;
+  flush();
+  std::fclose(file);
+}
+
+void FileSink::writeOut(const char* data, size_t size)
+{
+  if (file != nullptr)
+    std::fwrite(data, 1, size, file);
+}
+
+void BufferSink::writeOut(const char* data, size_t size)
+{
+  contents.append(data, size);
+}
+
+size_t formatNumber(double number, char* buffer, size_t size)
+{
+  double magnitude = std::fabs(number);
+  if (magnitude == 0 || !std::isfinite(number))
+    return std::to_chars(buffer, buffer + size, number).ptr - buffer;
+
+  if (magnitude < 1e-6 || magnitude >= 1e21)
+    return std::to_chars(buffer, buffer + size, number, std::chars_format::scientific).ptr - buffer;
+
+  /*
+   * plain to_chars takes whichever notation is shorter, 100000 came out
+   * as 1e+05. fixed would print all the digits of big doubles, so the
+   * shortest digits come as d.ddde+x and get moved around the '.'
+   */
+  char digits[32];
+  char* end = std::to_chars(digits, digits + sizeof(digits), number, std::chars_format::scientific).ptr;
+  char* e = std::find(digits, end, 'e');
+  int exponent = 0;
+  std::from_chars(e[1] == '+' ? e + 2 : e + 1, end, exponent);
+  char* out = buffer;
+  const char* p = digits;
+  if (*p == '-')
+    *out++ = *p++;
+  /* the digits without the '.', at most 17 */
+  char significant[24];
+  int count = std::remove_copy(p, (const char*)e, significant, '.') - significant;
+
+  if (exponent < 0)
+  {
+    out = std::copy_n("0.", 2, out);
+    out = std::fill_n(out, -exponent - 1, '0');
+    out = std::copy_n(significant, count, out);
+  }
+  else if (count <= exponent + 1)
+  {
+    out = std::copy_n(significant, count, out);
+    out = std::fill_n(out, exponent + 1 - count, '0');
+  }
+  else
+  {
+    out = std::copy_n(significant, exponent + 1, out);
+    *out++ = '.';
+    out = std::copy_n(significant + exponent + 1, count - exponent - 1, out);
+  }
+  return out - buffer;
+}
+
+std::string numberToString(double number)
+{
+  char chars[32];
+  return std::string(chars, formatNumber(number, chars, sizeof(chars)));
+}
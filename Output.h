@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+enum FlushPolicy
+{
+  FLUSH_LINE,     /* flush after every print, what the REPL wants */
+  FLUSH_SIZE,     /* flush when the buffer fills up */
+  FLUSH_EXPLICIT  /* only flush when somebody calls flush() */
+};
+
+/*
+ * Where print goes. Output is collected in a buffer and handed to
+ * writeOut() according to the flush policy, so a script printing
+ * millions of lines doesn't do a syscall per line.
+ */
+class OutputSink
+{
+public:
+  OutputSink(FlushPolicy policy = FLUSH_SIZE, size_t capacity = 64 * 1024)
+    : policy(policy), capacity(capacity)
+  {
+    buffer.reserve(capacity);
+  }
+  virtual ~OutputSink() = default;
+
+  void write(std::string_view str);
+  void writeNumber(double number);
+  void endLine();
+  void flush();
+
+  void setPolicy(FlushPolicy policy) { this->policy = policy; }
+  FlushPolicy getPolicy() const { return policy; }
+protected:
+  virtual void writeOut(const char* data, size_t size) = 0;
+private:
+  FlushPolicy policy;
+  size_t capacity;
+  std::string buffer;
+};
+
+class StdoutSink : public OutputSink
+{
+public:
+  using OutputSink::OutputSink;
+  ~StdoutSink() { flush(); }
+protected:
+  void writeOut(const char* data, size_t size) override;
+};
+
+class FileSink : public OutputSink
+{
+public:
+  FileSink(const std::string& path, FlushPolicy policy = FLUSH_SIZE);
+  ~FileSink();
+  bool isOpen() const { return file != nullptr; }
+protected:
+  void writeOut(const char* data, size_t size) override;
+private:
+  FILE* file;
+};
+
+/* keeps everything in memory, used by the emscripten crun() entry point */
+class BufferSink : public OutputSink
+{
+public:
+  BufferSink() : OutputSink(FLUSH_EXPLICIT, 0) {}
+  const std::string& getContents() { flush(); return contents; }
+  void clear() { flush(); contents.clear(); }
+protected:
+  void writeOut(const char* data, size_t size) override;
+private:
+  std::string contents;
+};
+
+/*
+ * shortest digits that read back as the same double, "2" not "2.000000".
+ * fixed notation from 1e-6 up to 1e21 like JavaScript, scientific outside
+ */
+size_t formatNumber(double number, char* buffer, size_t size);
+std::string numberToString(double number);
@@ -86,12 +86,13 @@ bool Parser::check(TokenType type)
   return peek().type == type;
 }
 
-static void error(const Token& token, std::string msg)
+void Parser::error(const Token& token, std::string msg)
 {
+  failed = true;
   if (token.type == _EOF_)
-    std::cerr << "PARSER ERROR: [" << token.line << "] at end: " << msg << std::endl;
+    errors << "PARSER ERROR: [" << token.line << "] at end: " << msg << std::endl;
   else
-    std::cerr << "PARSER ERROR: [" << token.line << "] at '" << token.lexeme << "': " << msg << std::endl;
+    errors << "PARSER ERROR: [" << token.line << "] at '" << token.lexeme << "': " << msg << std::endl;
 }
 
 std::list<std::unique_ptr<Stmt>> Parser::parse()
@@ -123,16 +124,16 @@ std::unique_ptr<Stmt> Parser::declaration()
 
 std::unique_ptr<Stmt> Parser::function(std::string functionType)
 {
-  Token name = consume(IDENTIFIER, "Expected " + functionType + " name type shii");
+  const Token& name = consume(IDENTIFIER, "Expected " + functionType + " name type shii");
   consume(LEFT_PAREN, "Expected '(' after " + functionType + " name");
-  std::vector<Token> parameters;
+  std::vector<const Token*> parameters;
   if (!check(RIGHT_PAREN))
   {
     do
     {
       if (parameters.size() > 255) 
         error(peek(), "Hey! Fuck you! You cannot have more than 255 parameters.");
-      parameters.push_back(consume(IDENTIFIER, "Expected parameter name after ','"));
+      parameters.push_back(&consume(IDENTIFIER, "Expected parameter name after ','"));
     } while (match(COMMA));
   }
   consume(RIGHT_PAREN, "Expected ')' after parameters.");
@@ -143,7 +144,7 @@ std::unique_ptr<Stmt> Parser::function(std::string functionType)
 
 std::unique_ptr<Stmt> Parser::varDeclaration()
 {
-  Token name = consume(IDENTIFIER, "Except variable name.");
+  const Token& name = consume(IDENTIFIER, "Except variable name.");
   std::unique_ptr<Expr> initializer = nullptr;
   if (match(EQUAL))
     initializer = expression();
@@ -166,9 +167,9 @@ std::unique_ptr<Stmt> Parser::statement()
 
 std::unique_ptr<Stmt> Parser::returnStatement()
 {
-  Token token = previous();
+  const Token& token = previous();
   if (match(SEMICOLON))
-    return std::make_unique<Return>(token, std::make_unique<Literal>(std::any()));
+    return std::make_unique<Return>(token, std::make_unique<Literal>(Value()));
   auto value = expression();
   consume(SEMICOLON, "Expected ';' after return statement");
   return std::make_unique<Return>(token, std::move(value));
@@ -176,14 +177,16 @@ std::unique_ptr<Stmt> Parser::returnStatement()
 
 std::unique_ptr<Stmt> Parser::breakStatement()
 {
+  const Token& keyword = previous();
   consume(SEMICOLON, "You did not place ';' after break... *sigh* Give me a break... Let's break up.");
-  return std::make_unique<Break>();  
+  return std::make_unique<Break>(keyword);  
 }
 
 std::unique_ptr<Stmt> Parser::continueStatement()
 {
+  const Token& keyword = previous();
   consume(SEMICOLON, "Expected ';' after continue.");
-  return std::make_unique<Continue>();
+  return std::make_unique<Continue>(keyword);
 }
 
 std::vector<std::unique_ptr<Stmt>> Parser::block()
@@ -247,12 +250,13 @@ std::unique_ptr<Stmt> Parser::whileStatement()
 
 std::unique_ptr<Stmt> Parser::ifStatement()
 {
+  const Token& keyword = previous();
   consume(LEFT_PAREN, "Expected '(' after 'if'");
   auto condition = expression();
   consume(RIGHT_PAREN, "Expected ')' after condition");
   auto thenBranch = statement();
   auto elseBranch = (match(ELSE)) ? statement() : nullptr;
-  return std::make_unique<If>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
+  return std::make_unique<If>(keyword, std::move(condition), std::move(thenBranch), std::move(elseBranch));
 }
 
 std::unique_ptr<Stmt> Parser::printStatement()
@@ -266,10 +270,12 @@ std::unique_ptr<Expr> Parser::primary()
 {
   if (match(FALSE))      return std::make_unique<Literal>(false);
   if (match(TRUE))       return std::make_unique<Literal>(true);
-  if (match(NIL))        return std::make_unique<Literal>(std::any());
+  if (match(NIL))        return std::make_unique<Literal>(Value());
   if (match(IDENTIFIER)) return std::make_unique<Variable>(previous());
-  if (match(NUMBER) || match(STRING))
-    return std::make_unique<Literal>(previous().lit);
+  if (match(NUMBER))
+    return std::make_unique<Literal>(previous().number());
+  if (match(STRING))
+    return std::make_unique<Literal>(Value(new String(std::string(previous().string()))));
   if (match(LEFT_PAREN))
   {
     auto grExpr = expression();
@@ -294,7 +300,7 @@ std::unique_ptr<Expr> Parser::finishCall(std::unique_ptr<Expr> callee)
     } while(match(COMMA));
   }
 
-  Token paren = consume(RIGHT_PAREN, "Expected '(' after arguments.");
+  const Token& paren = consume(RIGHT_PAREN, "Expected '(' after arguments.");
   return std::make_unique<Call>(std::move(callee), paren, std::move(args));
 }
 
@@ -334,7 +340,7 @@ std::unique_ptr<Expr> Parser::unary()
 {
   if (match(BANG) || match(MINUS))
   {
-    Token op = previous();
+    const Token& op = previous();
     auto right = unary();
     return std::make_unique<Unary>(op, std::move(right));
   }
@@ -348,7 +354,7 @@ std::unique_ptr<Expr> Parser::factor()
 
   while (match(SLASH) || match(STAR))
   {
-    Token op = previous();
+    const Token& op = previous();
     auto right = unary();
     /* move current unique_ptr expr and create a new one with make_unique */
     expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
@@ -363,7 +369,7 @@ std::unique_ptr<Expr> Parser::term()
 
   while (match(MINUS) || match(PLUS))
   {
-    Token op = previous();
+    const Token& op = previous();
     auto right = factor();
     expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
   }
@@ -378,7 +384,7 @@ std::unique_ptr<Expr> Parser::comparision()
   while (match(GREATER) || match(GREATER_EQUAL) ||
          match(LESS)    || match(LESS_EQUAL))
   {
-    Token op = previous();
+    const Token& op = previous();
     auto right = term();
     expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
   }
@@ -391,7 +397,7 @@ std::unique_ptr<Expr> Parser::equality()
 
   while (match(BANG_EQUAL) || match(EQUAL_EQUAL))
   {
-    Token op = previous();
+    const Token& op = previous();
     auto right = comparision();
     expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
   }
@@ -405,7 +411,7 @@ std::unique_ptr<Expr> Parser::andExpr()
 
   while (match(AND))
   {
-    Token op = previous();
+    const Token& op = previous();
     auto right = andExpr();
     expr = std::make_unique<Logical>(std::move(expr), op, std::move(right));
   }
@@ -419,7 +425,7 @@ std::unique_ptr<Expr> Parser::orExpr()
 
   while (match(OR))
   {
-    Token op = previous();
+    const Token& op = previous();
     auto right = andExpr();
     expr = std::make_unique<Logical>(std::move(expr), op, std::move(right));
   }
@@ -433,12 +439,12 @@ std::unique_ptr<Expr> Parser::assignment()
 
   if (match(EQUAL))
   {
-    const Token equals = previous();
+    const Token& equals = previous();
     auto value = assignment();
 
     if (dynamic_cast<Variable*>(expr.get()))
     {
-      Token name = static_cast<Variable*>(expr.get())->getName();
+      const Token& name = static_cast<Variable*>(expr.get())->getName();
       return std::make_unique<Assign>(name, std::move(value));
     }
     
@@ -450,14 +456,14 @@ std::unique_ptr<Expr> Parser::assignment()
 std::unique_ptr<Expr> Parser::lambda()
 {
   consume(LEFT_PAREN, "Expected '(' for lambda parameters.");
-  std::vector<Token> parameters;
+  std::vector<const Token*> parameters;
   if (!check(RIGHT_PAREN))
   {
     do
     {
       if (parameters.size() > 255)
         error(peek(), "Hey! Fuck you! You cannot have more than 255 parameters.");
-      parameters.push_back(consume(IDENTIFIER, "Expected parameter name after ','"));
+      parameters.push_back(&consume(IDENTIFIER, "Expected parameter name after ','"));
     } while (match(COMMA));
   }
   consume(RIGHT_PAREN, "Expected ')' after parameters.");
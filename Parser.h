@@ -1,4 +1,5 @@
 #pragma once
+#include <iostream>
 #include <vector>
 #include <list>
 #include "Stmt.h"
@@ -6,8 +7,11 @@
 class Parser
 {
 public:
-  Parser(const std::vector<Token>& tokens) : tokens(tokens) {}
+  /* nodes point into tokens, they have to outlive the AST (see Program.h) */
+  Parser(const std::vector<Token>& tokens, std::ostream& errors = std::cerr) : tokens(tokens), errors(errors) {}
   std::list<std::unique_ptr<Stmt>> parse();
+  /* the statements with errors were left out of what parse() returned */
+  bool hadErrors() const { return failed; }
 private:
   std::unique_ptr<Stmt> declaration();
   std::unique_ptr<Stmt> function(std::string functionType);
@@ -46,7 +50,10 @@ private:
   const Token& peek();
   const Token& previous();
   void synchronize();
+  void error(const Token& token, std::string msg);
 private:
   int current = 0;
-  std::vector<Token> tokens;
+  const std::vector<Token>& tokens;
+  std::ostream& errors;
+  bool failed = false;
 };
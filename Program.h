@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Arena.h"
+#include "Source.h"
+#include "Stmt.h"
+#include <list>
+#include <vector>
+
+/*
+ * One run() of source (a mapped file or a string, see Source.h): its
+ * tokens, the AST and the Arena the nodes are in. Tokens point into the
+ * source and nodes point at their tokens instead of copying them, so
+ * each has to stay put as long as what points into it, which the order
+ * here takes care of. Engines keep every program they ran since
+ * functions point into it (the REPL).
+ */
+struct Program
+{
+	Source source;
+	Arena arena;
+	/* one vector per piece the front end lexed the source in (FrontEnd.h), moving them doesn't move the tokens */
+	std::vector<std::vector<Token>> tokens;
+	std::list<std::unique_ptr<Stmt>> statements;
+};
@@ -0,0 +1,810 @@
+#include "ProgramCache.h"
+#include "Stats.h"
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <unistd.h>
+#elif defined(_WIN32)
+  #include <process.h>
+#endif
+
+/* "LSC" and a 0, a file from a machine with the other byte order reads as something else */
+static constexpr uint32_t MAGIC = 0x0043534c;
+/* magic, version, the source's hash and size, optimized, then the hash of everything after the header */
+static constexpr size_t HEADER_SIZE = 4 + 4 + 8 + 8 + 1 + 8;
+
+enum NodeTag : uint8_t
+{
+  /* an If without else, a Var without initializer */
+  NODE_NONE,
+  NODE_CALL, NODE_LOGICAL, NODE_BINARY, NODE_GROUPING, NODE_LITERAL,
+  NODE_UNARY, NODE_VARIABLE, NODE_ASSIGN, NODE_LAMBDA,
+  NODE_RETURN, NODE_FUNCTION, NODE_BREAK, NODE_CONTINUE, NODE_IF,
+  NODE_BLOCK, NODE_EXPRESSION, NODE_PRINT, NODE_VAR, NODE_WHILE
+};
+
+static uint64_t mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+/*
+ * 8 bytes at a time in four lanes that don't wait on each other, it
+ * runs on every cached start. not a cryptographic hash, whoever can
+ * write the cache file can write the script too. the cache file's
+ * contents are hashed the same way, a damaged one never runs
+ */
+static uint64_t hashBytes(std::string_view src)
+{
+  const uint64_t K1 = 0x87c37b91114253d5ull;
+  const uint64_t K2 = 0x4cf5ad432745937full;
+  uint64_t lanes[4] = { 1, 2, 3, 4 };
+  const char* p = src.data();
+  const char* end = p + src.size();
+  for (; end - p >= 32; p += 32)
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      uint64_t word;
+      std::memcpy(&word, p + i * 8, 8);
+      lanes[i] = std::rotl(lanes[i] ^ (word * K1), 31) * K2;
+    }
+  }
+  uint64_t h = src.size();
+  for (uint64_t lane : lanes)
+    h = mix(h ^ lane);
+  for (; p < end; p++)
+    h = (h ^ (uint8_t)*p) * K1;
+  return mix(h);
+}
+
+/*
+ * The nodes in preorder. A token goes in the first time a node points at
+ * it, after that nodes say how many tokens back it was. Lines and
+ * offsets are written as the difference to the token before, in 7 bit
+ * varints, they're mostly a byte. The names identifiers use go in a
+ * table in front of the nodes.
+ */
+class Writer : public ExprVisitor<Value>, public StmtVisitor<Completion>
+{
+public:
+  Writer(const Program& program)
+    : program(program), source(program.source.view()), nameIds(Symbols::count(), 0)
+  {
+    size_t count = 0;
+    for (const auto& tokens : program.tokens)
+      count += tokens.size();
+    tokenIds.resize(count, 0);
+  }
+
+  /* false if there's something in the AST that can't be saved */
+  bool write(std::string& out)
+  {
+    for (const auto& statement : program.statements)
+      putStmt(statement.get());
+    if (failed)
+      return false;
+
+    std::string nodes = std::move(data);
+    data.clear();
+    putVarint(names.size());
+    for (Symbol symbol : names)
+      putString(Symbols::name(symbol));
+    putVarint(tokenCount);
+    putVarint(program.statements.size());
+    out += data;
+    out += nodes;
+    return true;
+  }
+
+  Completion visitReturnStmt(Return& stmt) override
+  {
+    put<uint8_t>(NODE_RETURN);
+    putToken(stmt.getToken());
+    putExpr(&stmt.getValue());
+    return {};
+  }
+
+  Completion visitFunctionStmt(Function& stmt) override
+  {
+    put<uint8_t>(NODE_FUNCTION);
+    putToken(stmt.getName());
+    putFunction(stmt.getInfo());
+    return {};
+  }
+
+  Completion visitBreakStmt(Break& stmt) override
+  {
+    put<uint8_t>(NODE_BREAK);
+    putToken(stmt.getKeyword());
+    return {};
+  }
+
+  Completion visitContinueStmt(Continue& stmt) override
+  {
+    put<uint8_t>(NODE_CONTINUE);
+    putToken(stmt.getKeyword());
+    return {};
+  }
+
+  Completion visitIfStmt(If& stmt) override
+  {
+    put<uint8_t>(NODE_IF);
+    putToken(stmt.getKeyword());
+    putExpr(&stmt.getCondition());
+    putStmt(&stmt.getThen());
+    putStmt(stmt.hasElse() ? &stmt.getElse() : nullptr);
+    return {};
+  }
+
+  Completion visitBlockStmt(Block& stmt) override
+  {
+    put<uint8_t>(NODE_BLOCK);
+    putStmts(stmt.getStatements());
+    return {};
+  }
+
+  Completion visitExpressionStmt(Expression& stmt) override
+  {
+    put<uint8_t>(NODE_EXPRESSION);
+    putExpr(&stmt.getExpr());
+    return {};
+  }
+
+  Completion visitPrintStmt(Print& stmt) override
+  {
+    put<uint8_t>(NODE_PRINT);
+    putExpr(&stmt.getExpr());
+    return {};
+  }
+
+  Completion visitVarStmt(Var& stmt) override
+  {
+    put<uint8_t>(NODE_VAR);
+    putToken(stmt.getName());
+    putExpr(stmt.hasInitializer() ? &stmt.getInitializer() : nullptr);
+    return {};
+  }
+
+  Completion visitWhileStmt(While& stmt) override
+  {
+    put<uint8_t>(NODE_WHILE);
+    putExpr(&stmt.getCondition());
+    putStmt(&stmt.getBody());
+    return {};
+  }
+
+  Value visitLambdaExpr(Lambda& expr) override
+  {
+    put<uint8_t>(NODE_LAMBDA);
+    putFunction(expr.getInfo());
+    return {};
+  }
+
+  Value visitCallExpr(Call& expr) override
+  {
+    put<uint8_t>(NODE_CALL);
+    putExpr(&expr.getCallee());
+    putToken(expr.getParen());
+    putVarint(expr.getArgs().size());
+    for (const auto& arg : expr.getArgs())
+      putExpr(arg.get());
+    return {};
+  }
+
+  Value visitLogicalExpr(Logical& expr) override
+  {
+    put<uint8_t>(NODE_LOGICAL);
+    putExpr(&expr.getLeft());
+    putToken(expr.getOp());
+    putExpr(&expr.getRight());
+    return {};
+  }
+
+  Value visitBinaryExpr(Binary& expr) override
+  {
+    put<uint8_t>(NODE_BINARY);
+    putExpr(&expr.getLeft());
+    putToken(expr.getOp());
+    putExpr(&expr.getRight());
+    return {};
+  }
+
+  Value visitGroupingExpr(Grouping& expr) override
+  {
+    put<uint8_t>(NODE_GROUPING);
+    putExpr(&expr.getExpr());
+    return {};
+  }
+
+  Value visitLiteralExpr(Literal& expr) override
+  {
+    put<uint8_t>(NODE_LITERAL);
+    const Value& value = expr.getLit();
+    put<uint8_t>(value.getType());
+    switch (value.getType())
+    {
+    case VAL_NIL:    break;
+    case VAL_BOOL:   put<uint8_t>(value.asBool()); break;
+    case VAL_NUMBER: put<double>(value.asNumber()); break;
+    case VAL_STRING: putString(value.asString()->getChars()); break;
+    default:         failed = true; break;
+    }
+    return {};
+  }
+
+  Value visitUnaryExpr(Unary& expr) override
+  {
+    put<uint8_t>(NODE_UNARY);
+    putToken(expr.getOp());
+    putExpr(&expr.getRight());
+    return {};
+  }
+
+  Value visitVariableExpr(Variable& expr) override
+  {
+    put<uint8_t>(NODE_VARIABLE);
+    putToken(expr.getName());
+    return {};
+  }
+
+  Value visitAssignExpr(Assign& expr) override
+  {
+    put<uint8_t>(NODE_ASSIGN);
+    putToken(expr.getName());
+    putExpr(&expr.getValue());
+    return {};
+  }
+private:
+  template <typename T>
+  void put(T value)
+  {
+    data.append((const char*)&value, sizeof(T));
+  }
+
+  void putVarint(uint64_t value)
+  {
+    for (; value >= 0x80; value >>= 7)
+      data += (char)(value | 0x80);
+    data += (char)value;
+  }
+
+  /* small negative numbers small too */
+  void putSigned(int64_t value)
+  {
+    putVarint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+  }
+
+  void putString(const std::string& string)
+  {
+    putVarint(string.size());
+    data += string;
+  }
+
+  /* where token is in the program's tokens, counting across the front end's pieces */
+  bool indexOf(const Token& token, size_t& index)
+  {
+    size_t base = 0;
+    for (const auto& tokens : program.tokens)
+    {
+      if (&token >= tokens.data() && &token < tokens.data() + tokens.size())
+      {
+        index = base + (&token - tokens.data());
+        return true;
+      }
+      base += tokens.size();
+    }
+    return false;
+  }
+
+  void putToken(const Token& token)
+  {
+    size_t index;
+    if (!indexOf(token, index))
+    {
+      failed = true;
+      return;
+    }
+    if (tokenIds[index] != 0)
+    {
+      putVarint(tokenCount + 1 - tokenIds[index]);
+      return;
+    }
+    tokenIds[index] = ++tokenCount;
+    putVarint(0);
+
+    /* the EOF token's lexeme isn't in the source */
+    bool inSource = token.lexeme.data() >= source.data() && token.lexeme.data() + token.lexeme.size() <= source.data() + source.size();
+    size_t offset = inSource ? token.lexeme.data() - source.data() : lastEnd;
+    size_t length = inSource ? token.lexeme.size() : 0;
+    put<uint8_t>(token.type);
+    putSigned((int64_t)token.line - lastLine);
+    putSigned((int64_t)offset - (int64_t)lastEnd);
+    putVarint(length);
+    if (token.type == NUMBER)
+      put<double>(token.number());
+    else if (token.type == IDENTIFIER)
+      putVarint(nameId(token.symbol()));
+    lastLine = token.line;
+    lastEnd = offset + length;
+  }
+
+  uint32_t nameId(Symbol symbol)
+  {
+    if (nameIds[symbol] == 0)
+    {
+      names.push_back(symbol);
+      nameIds[symbol] = names.size();
+    }
+    return nameIds[symbol] - 1;
+  }
+
+  void putExpr(Expr* expr)
+  {
+    if (expr == nullptr)
+      put<uint8_t>(NODE_NONE);
+    else
+      expr->accept(*this);
+  }
+
+  void putStmt(Stmt* stmt)
+  {
+    if (stmt == nullptr)
+      put<uint8_t>(NODE_NONE);
+    else
+      stmt->accept(*this);
+  }
+
+  void putStmts(const std::vector<std::unique_ptr<Stmt>>& statements)
+  {
+    putVarint(statements.size());
+    for (const auto& statement : statements)
+      putStmt(statement.get());
+  }
+
+  void putFunction(FunctionInfo& info)
+  {
+    putVarint(info.getParams().size());
+    for (const Token* param : info.getParams())
+      putToken(*param);
+    putStmts(info.getBody());
+  }
+private:
+  const Program& program;
+  std::string_view source;
+  std::string data;
+  /* by where they are in the program's tokens, 0 for not written yet or the 1 based order they were written in */
+  std::vector<size_t> tokenIds;
+  size_t tokenCount = 0;
+  int lastLine = 0;
+  size_t lastEnd = 0;
+  /* by Symbol, 0 or 1 + the name's index in names */
+  std::vector<uint32_t> nameIds;
+  std::vector<Symbol> names;
+  bool failed = false;
+};
+
+/*
+ * Every read is bounds checked, a truncated or damaged file fails the
+ * read instead of building something from garbage. Nodes go in
+ * Arena::current.
+ */
+class Reader
+{
+public:
+  Reader(std::string_view data, std::string_view source, std::vector<Token>& tokens)
+    : p(data.data()), end(data.data() + data.size()), source(source), tokens(tokens)
+  {}
+
+  /* the header's been checked, the rest is what Writer::write wrote */
+  bool read(std::list<std::unique_ptr<Stmt>>& statements)
+  {
+    uint64_t nameCount = getVarint();
+    if (!fits(nameCount))
+      return false;
+    symbols.reserve(nameCount);
+    for (uint64_t i = 0; i < nameCount && !failed; i++)
+      symbols.push_back(Symbols::intern(getString()));
+
+    /* reserved up front, nodes point at them */
+    tokenCount = getVarint();
+    if (!fits(tokenCount))
+      return false;
+    tokens.reserve(tokenCount);
+
+    uint64_t statementCount = getVarint();
+    if (!fits(statementCount))
+      return false;
+    for (uint64_t i = 0; i < statementCount && !failed; i++)
+      statements.push_back(getStmt(get<uint8_t>()));
+    return !failed && p == end && tokens.size() == tokenCount;
+  }
+private:
+  template <typename T>
+  T get()
+  {
+    T value{};
+    if ((size_t)(end - p) < sizeof(T))
+    {
+      failed = true;
+      return value;
+    }
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+  }
+
+  uint64_t getVarint()
+  {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7)
+    {
+      uint8_t byte = *p++;
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if (byte < 0x80)
+        return value;
+    }
+    failed = true;
+    return 0;
+  }
+
+  int64_t getSigned()
+  {
+    uint64_t value = getVarint();
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+  }
+
+  /* whether count things of a byte or more can still be in the file */
+  bool fits(uint64_t count)
+  {
+    if (count > (uint64_t)(end - p))
+      failed = true;
+    return !failed;
+  }
+
+  std::string_view getString()
+  {
+    uint64_t length = getVarint();
+    if (!fits(length))
+      return {};
+    std::string_view string(p, length);
+    p += length;
+    return string;
+  }
+
+  const Token& getToken()
+  {
+    /* what a node gets when the read already failed, it's thrown away with it */
+    static const Token NONE(_EOF_, "", 0);
+    uint64_t back = getVarint();
+    if (back != 0)
+    {
+      if (back > tokens.size())
+      {
+        failed = true;
+        return NONE;
+      }
+      return tokens[tokens.size() - back];
+    }
+
+    uint8_t type = get<uint8_t>();
+    int64_t line = lastLine + getSigned();
+    int64_t offset = (int64_t)lastEnd + getSigned();
+    uint64_t length = getVarint();
+    if (failed || tokens.size() == tokenCount || type > _EOF_ || line < INT32_MIN || line > INT32_MAX || offset < 0 ||
+        (uint64_t)offset > source.size() || length > source.size() - offset)
+    {
+      failed = true;
+      return NONE;
+    }
+    std::string_view lexeme = source.substr(offset, length);
+    if (type == NUMBER)
+      tokens.emplace_back((TokenType)type, lexeme, get<double>(), (int)line);
+    else if (type == IDENTIFIER)
+    {
+      uint64_t name = getVarint();
+      if (name >= symbols.size())
+      {
+        failed = true;
+        return NONE;
+      }
+      tokens.emplace_back((TokenType)type, lexeme, symbols[name], (int)line);
+    }
+    else
+      tokens.emplace_back((TokenType)type, lexeme, (int)line);
+    lastLine = line;
+    lastEnd = offset + length;
+    return tokens.back();
+  }
+
+  Value getValue()
+  {
+    switch (get<uint8_t>())
+    {
+    case VAL_NIL:    return Value();
+    case VAL_BOOL:   return Value(get<uint8_t>() != 0);
+    case VAL_NUMBER: return Value(get<double>());
+    case VAL_STRING: return Value(new String(std::string(getString())));
+    default:         failed = true; return Value();
+    }
+  }
+
+  std::vector<const Token*> getParams()
+  {
+    std::vector<const Token*> params;
+    uint64_t count = getVarint();
+    if (!fits(count))
+      return params;
+    params.reserve(count);
+    for (uint64_t i = 0; i < count && !failed; i++)
+      params.push_back(&getToken());
+    return params;
+  }
+
+  std::vector<std::unique_ptr<Stmt>> getStmts()
+  {
+    std::vector<std::unique_ptr<Stmt>> statements;
+    uint64_t count = getVarint();
+    if (!fits(count))
+      return statements;
+    statements.reserve(count);
+    for (uint64_t i = 0; i < count && !failed; i++)
+      statements.push_back(getStmt(get<uint8_t>()));
+    return statements;
+  }
+
+  /*
+   * things have to be read in the order the Writer wrote them, arguments
+   * to one call are evaluated in no particular order so each is read
+   * into a local first
+   */
+  std::unique_ptr<Expr> getExpr(uint8_t tag)
+  {
+    switch (tag)
+    {
+    case NODE_NONE:
+      return nullptr;
+    case NODE_CALL:
+    {
+      auto callee = getExpr(get<uint8_t>());
+      const Token& paren = getToken();
+      uint64_t count = getVarint();
+      std::vector<std::unique_ptr<Expr>> args;
+      if (fits(count))
+      {
+        args.reserve(count);
+        for (uint64_t i = 0; i < count && !failed; i++)
+          args.push_back(getExpr(get<uint8_t>()));
+      }
+      return std::make_unique<Call>(std::move(callee), paren, std::move(args));
+    }
+    case NODE_LOGICAL:
+    case NODE_BINARY:
+    {
+      auto left = getExpr(get<uint8_t>());
+      const Token& op = getToken();
+      auto right = getExpr(get<uint8_t>());
+      if (tag == NODE_LOGICAL)
+        return std::make_unique<Logical>(std::move(left), op, std::move(right));
+      return std::make_unique<Binary>(std::move(left), op, std::move(right));
+    }
+    case NODE_GROUPING:
+      return std::make_unique<Grouping>(getExpr(get<uint8_t>()));
+    case NODE_LITERAL:
+      return std::make_unique<Literal>(getValue());
+    case NODE_UNARY:
+    {
+      const Token& op = getToken();
+      return std::make_unique<Unary>(op, getExpr(get<uint8_t>()));
+    }
+    case NODE_VARIABLE:
+      return std::make_unique<Variable>(getToken());
+    case NODE_ASSIGN:
+    {
+      const Token& name = getToken();
+      return std::make_unique<Assign>(name, getExpr(get<uint8_t>()));
+    }
+    case NODE_LAMBDA:
+    {
+      auto params = getParams();
+      return std::make_unique<Lambda>(std::move(params), getStmts());
+    }
+    default:
+      failed = true;
+      return nullptr;
+    }
+  }
+
+  std::unique_ptr<Stmt> getStmt(uint8_t tag)
+  {
+    switch (tag)
+    {
+    case NODE_NONE:
+      return nullptr;
+    case NODE_RETURN:
+    {
+      const Token& token = getToken();
+      return std::make_unique<Return>(token, getExpr(get<uint8_t>()));
+    }
+    case NODE_FUNCTION:
+    {
+      const Token& name = getToken();
+      auto params = getParams();
+      return std::make_unique<Function>(name, std::move(params), getStmts());
+    }
+    case NODE_BREAK:
+      return std::make_unique<Break>(getToken());
+    case NODE_CONTINUE:
+      return std::make_unique<Continue>(getToken());
+    case NODE_IF:
+    {
+      const Token& keyword = getToken();
+      auto condition = getExpr(get<uint8_t>());
+      auto thenBranch = getStmt(get<uint8_t>());
+      return std::make_unique<If>(keyword, std::move(condition), std::move(thenBranch), getStmt(get<uint8_t>()));
+    }
+    case NODE_BLOCK:
+      return std::make_unique<Block>(getStmts());
+    case NODE_EXPRESSION:
+      return std::make_unique<Expression>(getExpr(get<uint8_t>()));
+    case NODE_PRINT:
+      return std::make_unique<Print>(getExpr(get<uint8_t>()));
+    case NODE_VAR:
+    {
+      const Token& name = getToken();
+      return std::make_unique<Var>(name, getExpr(get<uint8_t>()));
+    }
+    case NODE_WHILE:
+    {
+      auto condition = getExpr(get<uint8_t>());
+      return std::make_unique<While>(std::move(condition), getStmt(get<uint8_t>()));
+    }
+    default:
+      failed = true;
+      return nullptr;
+    }
+  }
+
+  const char* p;
+  const char* end;
+  std::string_view source;
+  std::vector<Token>& tokens;
+  uint64_t tokenCount = 0;
+  std::vector<Symbol> symbols;
+  int64_t lastLine = 0;
+  size_t lastEnd = 0;
+  bool failed = false;
+};
+
+/* part of the temp file's name, two runs saving the same script at once write different ones */
+static long processId()
+{
+#if defined(__unix__) || defined(__APPLE__)
+  return (long)getpid();
+#elif defined(_WIN32)
+  return (long)_getpid();
+#else
+  return 0;
+#endif
+}
+
+static std::string cachePath(const std::string& dir, const char* script, uint64_t hash, bool optimized)
+{
+  /* script.lsc and script.opt.lsc, so runs with and without --optimize don't replace each other's */
+  if (dir.empty() && !optimized)
+    return std::string(script) + "c";
+  if (dir.empty())
+  {
+    std::filesystem::path path(script);
+    std::string extension = path.extension().string();
+    return path.replace_extension(".opt" + extension + "c").string();
+  }
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << hash << (optimized ? "-opt" : "") << ".lsc";
+  return (std::filesystem::path(dir) / name.str()).string();
+}
+
+ProgramCache::ProgramCache(const std::string& dir, const char* script, std::string_view source, bool optimized)
+  : hash(hashBytes(source)), size(source.size()), optimized(optimized)
+{
+  path = cachePath(dir, script, hash, optimized);
+}
+
+bool ProgramCache::load(Program& program)
+{
+  Source file;
+  std::string_view data;
+  if (file.load(path.c_str()))
+    data = file.view();
+
+  bool valid = data.size() >= HEADER_SIZE;
+  if (valid)
+  {
+    uint32_t magic, version;
+    uint64_t fileHash, fileSize, checksum;
+    std::memcpy(&magic, data.data(), 4);
+    std::memcpy(&version, data.data() + 4, 4);
+    std::memcpy(&fileHash, data.data() + 8, 8);
+    std::memcpy(&fileSize, data.data() + 16, 8);
+    std::memcpy(&checksum, data.data() + 25, 8);
+    valid = magic == MAGIC && version == VERSION && fileHash == hash && fileSize == size && data[24] == (char)optimized &&
+            checksum == hashBytes(data.substr(HEADER_SIZE));
+  }
+
+  /* read into their own tokens and Arena, the Program only takes them if all went well */
+  std::vector<Token> tokens;
+  std::list<std::unique_ptr<Stmt>> statements;
+  Arena arena;
+  if (valid)
+  {
+    Arena::Scope scope(arena);
+    valid = Reader(data.substr(HEADER_SIZE), program.source.view(), tokens).read(statements);
+  }
+  if (!valid)
+  {
+    /* before the arena they're in */
+    statements.clear();
+    stats.cacheMisses++;
+    return false;
+  }
+
+  program.tokens.clear();
+  program.tokens.push_back(std::move(tokens));
+  program.statements = std::move(statements);
+  program.arena.adopt(arena);
+  stats.cacheHits++;
+  return true;
+}
+
+void ProgramCache::store(const Program& program)
+{
+  std::string data;
+  data.append((const char*)&MAGIC, 4);
+  data.append((const char*)&VERSION, 4);
+  data.append((const char*)&hash, 8);
+  data.append((const char*)&size, 8);
+  data += (char)optimized;
+  data.append(8, '\0');
+  if (!Writer(program).write(data))
+    return;
+  uint64_t checksum = hashBytes(std::string_view(data).substr(HEADER_SIZE));
+  std::memcpy(data.data() + 25, &checksum, 8);
+
+  /*
+   * written next to where it goes and renamed over it, another run of
+   * the same script never sees half a file
+   */
+  std::error_code error;
+  std::filesystem::path target(path);
+  if (target.has_parent_path())
+    std::filesystem::create_directories(target.parent_path(), error);
+  std::string temp = path + "." + std::to_string(processId()) + "." +
+    std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file)
+      return;
+    file.write(data.data(), data.size());
+    if (!file.flush())
+    {
+      file.close();
+      std::remove(temp.c_str());
+      return;
+    }
+  }
+  std::filesystem::rename(temp, target, error);
+  if (error)
+    std::remove(temp.c_str());
+}
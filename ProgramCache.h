@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Program.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * The parsed (and with --optimize, optimized) AST of a script saved to
+ * disk, so running an unchanged script again skips the Lexer and the
+ * Parser (--cache, --cache-dir). The file goes next to the script
+ * (script.ls -> script.lsc, script.opt.lsc with --optimize) or in a
+ * directory, named after the hash.
+ *
+ * A file is only used when its header matches: the format VERSION, a
+ * hash and the size of the source, and whether it was optimized.
+ * Anything else, a missing or unreadable file included, is a miss and
+ * the script gets parsed and saved again. Scripts with lexer or parser
+ * errors are never saved, they print their errors every time.
+ *
+ * Tokens are saved as where they are in the source plus their literal,
+ * the loaded ones point into the source like the Lexer's. Only tokens
+ * nodes point at are saved, identifiers are interned again by name.
+ */
+class ProgramCache
+{
+public:
+  /* dir empty for next to the script */
+  ProgramCache(const std::string& dir, const char* script, std::string_view source, bool optimized);
+
+  /* fills in program's tokens and statements, false on a miss */
+  bool load(Program& program);
+  /* after a front end run without errors, silently does nothing if the file can't be written */
+  void store(const Program& program);
+
+  /* bump when the Parser, the Optimizer or the nodes change what a script turns into */
+  static constexpr uint32_t VERSION = 1;
+private:
+  std::string path;
+  uint64_t hash;
+  uint64_t size;
+  bool optimized;
+};
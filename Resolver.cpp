@@ -0,0 +1,333 @@
+#include "Resolver.h"
+#include <iostream>
+
+void Resolver::error(const Token& token, std::string msg)
+{
+  std::cerr << "RESOLVER ERROR: [" << token.line << "] at '" << token.lexeme << "': " << msg << std::endl;
+  hadError = true;
+}
+
+bool Resolver::resolve(const std::list<std::unique_ptr<Stmt>>& statements)
+{
+  hadError = false;
+  script = { nullptr, nullptr };
+  current = &script;
+  for (const auto& statement : statements)
+    resolve(*statement);
+  return !hadError;
+}
+
+void Resolver::resolve(const std::vector<std::unique_ptr<Stmt>>& statements)
+{
+  for (const auto& statement : statements)
+  {
+    /* the parser leaves nullptrs behind in blocks after an error */
+    if (statement != nullptr)
+      resolve(*statement);
+  }
+}
+
+void Resolver::resolve(Stmt& stmt)
+{
+  stmt.accept(*this);
+}
+
+void Resolver::resolve(Expr& expr)
+{
+  expr.accept(*this);
+}
+
+int Resolver::getSlotCount()
+{
+  return script.slotCount;
+}
+
+void Resolver::beginScope()
+{
+  current->scopeDepth++;
+}
+
+void Resolver::endScope()
+{
+  current->scopeDepth--;
+  while (!current->locals.empty() && current->locals.back().depth > current->scopeDepth)
+    popLocal();
+}
+
+void Resolver::popLocal()
+{
+  Local& local = current->locals.back();
+  if (local.captured)
+  {
+    for (VarRef* use : local.uses)
+      use->kind = VAR_CELL;
+    for (VarDecl* decl : local.decls)
+      decl->boxed = true;
+    if (local.isParam)
+      current->info->boxedParams.push_back(local.slot);
+  }
+  current->locals.pop_back();
+}
+
+/* decl is null for params */
+void Resolver::declare(const Token& name, VarDecl* decl)
+{
+  /* top-level declarations are globals */
+  if (current == &script && current->scopeDepth == 0)
+  {
+    if (decl != nullptr)
+    {
+      decl->global = true;
+      decl->slot = globals.slotFor(name.symbol());
+    }
+    return;
+  }
+
+  /* var a = 1; var a = 2; in the same scope just reuses the slot */
+  int existing = findLocal(*current, name.symbol());
+  if (existing >= 0 && current->locals[existing].depth == current->scopeDepth)
+  {
+    if (decl != nullptr)
+    {
+      decl->slot = current->locals[existing].slot;
+      current->locals[existing].decls.push_back(decl);
+    }
+    return;
+  }
+
+  /*
+   * slots are never reused within a function, so a local that hasn't
+   * been assigned yet can't see a value left behind by another one
+   */
+  Local local;
+  local.name = name.symbol();
+  local.depth = current->scopeDepth;
+  local.slot = current->slotCount++;
+  local.isParam = (decl == nullptr);
+  if (decl != nullptr)
+  {
+    decl->slot = local.slot;
+    local.decls.push_back(decl);
+  }
+  current->locals.push_back(std::move(local));
+}
+
+int Resolver::findLocal(FunctionState& state, Symbol name)
+{
+  for (int i = state.locals.size() - 1; i >= 0; i--)
+  {
+    if (state.locals[i].name == name)
+      return i;
+  }
+  return -1;
+}
+
+int Resolver::addCapture(FunctionState& state, bool isLocal, int index)
+{
+  for (size_t i = 0; i < state.captures.size(); i++)
+  {
+    if (state.captures[i].isLocal == isLocal && state.captures[i].index == index)
+      return i;
+  }
+  state.captures.push_back({ isLocal, index });
+  return state.captures.size() - 1;
+}
+
+int Resolver::resolveUpvalue(FunctionState& state, Symbol name)
+{
+  if (state.enclosing == nullptr)
+    return -1;
+
+  int local = findLocal(*state.enclosing, name);
+  if (local >= 0)
+  {
+    state.enclosing->locals[local].captured = true;
+    return addCapture(state, true, state.enclosing->locals[local].slot);
+  }
+
+  int upvalue = resolveUpvalue(*state.enclosing, name);
+  if (upvalue >= 0)
+    return addCapture(state, false, upvalue);
+  return -1;
+}
+
+void Resolver::resolveVar(const Token& name, VarRef& ref)
+{
+  int local = findLocal(*current, name.symbol());
+  if (local >= 0)
+  {
+    ref.kind = VAR_LOCAL;
+    ref.index = current->locals[local].slot;
+    current->locals[local].uses.push_back(&ref);
+    return;
+  }
+
+  int upvalue = resolveUpvalue(*current, name.symbol());
+  if (upvalue >= 0)
+  {
+    ref.kind = VAR_UPVALUE;
+    ref.index = upvalue;
+    return;
+  }
+
+  /* not found, assume it's a global, it might only be defined later */
+  ref.kind = VAR_GLOBAL;
+  ref.index = globals.slotFor(name.symbol());
+}
+
+void Resolver::resolveFunction(FunctionInfo& info)
+{
+  FunctionState state = { current, &info };
+  int enclosingLoopDepth = loopDepth;
+  current = &state;
+  loopDepth = 0;
+
+  /* params and the body share one scope, see Callable::call */
+  beginScope();
+  for (const Token* param : info.getParams())
+    declare(*param, nullptr);
+  resolve(info.getBody());
+  endScope();
+
+  info.slotCount = state.slotCount;
+  info.captures = std::move(state.captures);
+  current = state.enclosing;
+  loopDepth = enclosingLoopDepth;
+}
+
+Completion Resolver::visitReturnStmt(Return& stmt)
+{
+  if (current == &script)
+    error(stmt.getToken(), "Can't return from top-level code.");
+  /* return f(x); reuses the caller's frame */
+  stmt.setTailCall(dynamic_cast<Call*>(&stmt.getValue()) != nullptr);
+  resolve(stmt.getValue());
+  return Completion();
+}
+
+Completion Resolver::visitFunctionStmt(Function& stmt)
+{
+  /* declared before the body so the function can call itself */
+  declare(stmt.getName(), &stmt.getDecl());
+  resolveFunction(stmt.getInfo());
+  return Completion();
+}
+
+Completion Resolver::visitBreakStmt(Break& stmt)
+{
+  if (loopDepth == 0)
+    error(stmt.getKeyword(), "Can't break outside of a loop.");
+  return Completion();
+}
+
+Completion Resolver::visitContinueStmt(Continue& stmt)
+{
+  if (loopDepth == 0)
+    error(stmt.getKeyword(), "Can't continue outside of a loop.");
+  return Completion();
+}
+
+Completion Resolver::visitWhileStmt(While& stmt)
+{
+  resolve(stmt.getCondition());
+  loopDepth++;
+  resolve(stmt.getBody());
+  loopDepth--;
+  return Completion();
+}
+
+Completion Resolver::visitIfStmt(If& stmt)
+{
+  resolve(stmt.getCondition());
+  resolve(stmt.getThen());
+  if (stmt.hasElse())
+    resolve(stmt.getElse());
+  return Completion();
+}
+
+Completion Resolver::visitExpressionStmt(Expression& stmt)
+{
+  resolve(stmt.getExpr());
+  return Completion();
+}
+
+Completion Resolver::visitPrintStmt(Print& stmt)
+{
+  resolve(stmt.getExpr());
+  return Completion();
+}
+
+Completion Resolver::visitVarStmt(Var& stmt)
+{
+  /* initializer first, var a = a; reads the outer a */
+  if (stmt.hasInitializer())
+    resolve(stmt.getInitializer());
+  declare(stmt.getName(), &stmt.getDecl());
+  return Completion();
+}
+
+Completion Resolver::visitBlockStmt(Block& stmt)
+{
+  beginScope();
+  resolve(stmt.getStatements());
+  endScope();
+  return Completion();
+}
+
+Value Resolver::visitCallExpr(Call& expr)
+{
+  resolve(expr.getCallee());
+  for (const auto& arg : expr.getArgs())
+    resolve(*arg);
+  return Value();
+}
+
+Value Resolver::visitLogicalExpr(Logical& expr)
+{
+  resolve(expr.getLeft());
+  resolve(expr.getRight());
+  return Value();
+}
+
+Value Resolver::visitBinaryExpr(Binary& expr)
+{
+  resolve(expr.getLeft());
+  resolve(expr.getRight());
+  return Value();
+}
+
+Value Resolver::visitGroupingExpr(Grouping& expr)
+{
+  resolve(expr.getExpr());
+  return Value();
+}
+
+Value Resolver::visitLiteralExpr(Literal& expr)
+{
+  return Value();
+}
+
+Value Resolver::visitUnaryExpr(Unary& expr)
+{
+  resolve(expr.getRight());
+  return Value();
+}
+
+Value Resolver::visitVariableExpr(Variable& expr)
+{
+  resolveVar(expr.getName(), expr.getRef());
+  return Value();
+}
+
+Value Resolver::visitAssignExpr(Assign& expr)
+{
+  resolve(expr.getValue());
+  resolveVar(expr.getName(), expr.getRef());
+  return Value();
+}
+
+Value Resolver::visitLambdaExpr(Lambda& expr)
+{
+  resolveFunction(expr.getInfo());
+  return Value();
+}
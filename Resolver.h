@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Stmt.h"
+#include <list>
+#include <unordered_map>
+
+/*
+ * Static pass that runs between Parser::parse and Interpreter::interpret.
+ * Every local gets a slot in the frame of the function that declares it
+ * (blocks don't get a frame of their own), and every Variable/Assign is
+ * annotated with where to find its variable. Locals of an enclosing
+ * function are captured clox style: the closure gets an upvalue and the
+ * local is boxed in a Cell. Names that aren't found anywhere are globals
+ * and get a slot in the interpreter's global table.
+ */
+class Resolver : public ExprVisitor<Value>, public StmtVisitor<Completion>
+{
+public:
+	Resolver(Environment& globals) : globals(globals) {}
+
+	/* returns false if there was an error, the program shouldn't run then */
+	bool resolve(const std::list<std::unique_ptr<Stmt>>& statements);
+	/* size of the frame for locals in top-level blocks */
+	int getSlotCount();
+private:
+	struct Local
+	{
+		Symbol name;
+		int depth;
+		int slot;
+		bool captured = false;
+		bool isParam = false;
+		/* patched to VAR_CELL when the scope ends if it got captured */
+		std::vector<VarRef*> uses;
+		/* more than one when the name is redeclared */
+		std::vector<VarDecl*> decls;
+	};
+
+	struct FunctionState
+	{
+		FunctionState* enclosing;
+		/* null for the top-level script */
+		FunctionInfo* info;
+		std::vector<Local> locals;
+		std::vector<Capture> captures;
+		int scopeDepth = 0;
+		int slotCount = 0;
+	};
+
+	void resolve(const std::vector<std::unique_ptr<Stmt>>& statements);
+	void resolve(Stmt& stmt);
+	void resolve(Expr& expr);
+	void resolveFunction(FunctionInfo& info);
+	void resolveVar(const Token& name, VarRef& ref);
+	int findLocal(FunctionState& state, Symbol name);
+	int resolveUpvalue(FunctionState& state, Symbol name);
+	int addCapture(FunctionState& state, bool isLocal, int index);
+	void beginScope();
+	void endScope();
+	void popLocal();
+	void declare(const Token& name, VarDecl* decl);
+	void error(const Token& token, std::string msg);
+
+	Completion visitReturnStmt(Return& stmt) override;
+	Completion visitFunctionStmt(Function& stmt) override;
+	Completion visitBreakStmt(Break& stmt) override;
+	Completion visitContinueStmt(Continue& stmt) override;
+	Completion visitWhileStmt(While& stmt) override;
+	Completion visitIfStmt(If& stmt) override;
+	Completion visitExpressionStmt(Expression& stmt) override;
+	Completion visitPrintStmt(Print& stmt) override;
+	Completion visitVarStmt(Var& stmt) override;
+	Completion visitBlockStmt(Block& stmt) override;
+	Value visitCallExpr(Call& expr) override;
+	Value visitLogicalExpr(Logical& expr) override;
+	Value visitBinaryExpr(Binary& expr) override;
+	Value visitGroupingExpr(Grouping& expr) override;
+	Value visitLiteralExpr(Literal& expr) override;
+	Value visitUnaryExpr(Unary& expr) override;
+	Value visitVariableExpr(Variable& expr) override;
+	Value visitAssignExpr(Assign& expr) override;
+	Value visitLambdaExpr(Lambda& expr) override;
+private:
+	Environment& globals;
+	FunctionState script = { nullptr, nullptr };
+	FunctionState* current = &script;
+	int loopDepth = 0;
+	bool hadError = false;
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define SCAN_SIMD
+#elif defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define SCAN_SIMD
+#endif
+
+/*
+ * The loops the Lexer spends its time in: whitespace, comments,
+ * identifiers and strings. On x86-64 they look at 16 bytes at a time with
+ * SSE2, which every x86-64 has, or 32 with AVX2 when it's compiled in
+ * (-mavx2 or -march=native). The last few bytes and every other target
+ * (wasm...) go one char at a time.
+ *
+ * Each one takes [p, end) and returns where the run stops, end if it
+ * doesn't. The ones that can cross lines add the newlines they pass to
+ * line.
+ */
+
+#ifdef SCAN_SIMD
+/* one chunk of source, the queries return a bit per byte */
+struct Chunk
+{
+#ifdef __AVX2__
+  static constexpr int SIZE = 32;
+
+  explicit Chunk(const char* p) : v(_mm256_loadu_si256((const __m256i*)p)) {}
+
+  uint32_t eq(char c) const
+  {
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+  }
+
+  /* lo <= byte <= hi, unsigned */
+  uint32_t inRange(char lo, char hi) const
+  {
+    __m256i offset = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    __m256i width = _mm256_set1_epi8((char)(hi - lo));
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(offset, width), width));
+  }
+
+  /* letters: lowercase everything and check one range */
+  uint32_t letter() const
+  {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i offset = _mm256_sub_epi8(lower, _mm256_set1_epi8('a'));
+    __m256i width = _mm256_set1_epi8('z' - 'a');
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(offset, width), width));
+  }
+
+  __m256i v;
+#else
+  static constexpr int SIZE = 16;
+
+  explicit Chunk(const char* p) : v(_mm_loadu_si128((const __m128i*)p)) {}
+
+  uint32_t eq(char c) const
+  {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+  }
+
+  uint32_t inRange(char lo, char hi) const
+  {
+    __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    __m128i width = _mm_set1_epi8((char)(hi - lo));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(offset, width), width));
+  }
+
+  uint32_t letter() const
+  {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i offset = _mm_sub_epi8(lower, _mm_set1_epi8('a'));
+    __m128i width = _mm_set1_epi8('z' - 'a');
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(offset, width), width));
+  }
+
+  __m128i v;
+#endif
+
+  static constexpr uint32_t ALL = SIZE == 32 ? 0xffffffffu : (1u << SIZE) - 1;
+};
+
+/* newlines before the first stop bit, or in all of the chunk if there's none */
+inline int newlinesBefore(uint32_t newlines, uint32_t stop)
+{
+  if (stop != 0)
+    newlines &= (stop - 1) & ~stop;
+  return std::popcount(newlines);
+}
+#endif
+
+inline bool isSpaceChar(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline const char* skipSpace(const char* p, const char* end, int& line)
+{
+  /* between tokens there's mostly nothing or one space, those don't need a chunk */
+  if (p == end || !isSpaceChar(*p))
+    return p;
+  if (*p == ' ' && p + 1 < end && !isSpaceChar(p[1]))
+    return p + 1;
+#ifdef SCAN_SIMD
+  while (end - p >= Chunk::SIZE)
+  {
+    Chunk chunk(p);
+    uint32_t newlines = chunk.eq('\n');
+    uint32_t stop = ~(chunk.eq(' ') | chunk.eq('\t') | chunk.eq('\r') | newlines) & Chunk::ALL;
+    line += newlinesBefore(newlines, stop);
+    if (stop != 0)
+      return p + std::countr_zero(stop);
+    p += Chunk::SIZE;
+  }
+#endif
+  for (; p < end; p++)
+  {
+    if (*p == '\n')
+      line++;
+    else if (!isSpaceChar(*p))
+      break;
+  }
+  return p;
+}
+
+inline bool isIdentifierChar(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline const char* skipIdentifier(const char* p, const char* end)
+{
+#ifdef SCAN_SIMD
+  while (end - p >= Chunk::SIZE)
+  {
+    Chunk chunk(p);
+    uint32_t stop = ~(chunk.letter() | chunk.inRange('0', '9') | chunk.eq('_')) & Chunk::ALL;
+    if (stop != 0)
+      return p + std::countr_zero(stop);
+    p += Chunk::SIZE;
+  }
+#endif
+  while (p < end && isIdentifierChar(*p))
+    p++;
+  return p;
+}
+
+/* the end of a // comment */
+inline const char* findNewline(const char* p, const char* end)
+{
+#ifdef SCAN_SIMD
+  while (end - p >= Chunk::SIZE)
+  {
+    uint32_t stop = Chunk(p).eq('\n');
+    if (stop != 0)
+      return p + std::countr_zero(stop);
+    p += Chunk::SIZE;
+  }
+#endif
+  while (p < end && *p != '\n')
+    p++;
+  return p;
+}
+
+/* the closing quote of a string */
+inline const char* findQuote(const char* p, const char* end, int& line)
+{
+#ifdef SCAN_SIMD
+  while (end - p >= Chunk::SIZE)
+  {
+    Chunk chunk(p);
+    uint32_t stop = chunk.eq('"');
+    line += newlinesBefore(chunk.eq('\n'), stop);
+    if (stop != 0)
+      return p + std::countr_zero(stop);
+    p += Chunk::SIZE;
+  }
+#endif
+  for (; p < end && *p != '"'; p++)
+  {
+    if (*p == '\n')
+      line++;
+  }
+  return p;
+}
+
+/* the star of the star-slash closing a block comment */
+inline const char* findCommentEnd(const char* p, const char* end, int& line)
+{
+#ifdef SCAN_SIMD
+  /* the byte after each one is in a second chunk one further on */
+  while (end - p > Chunk::SIZE)
+  {
+    Chunk chunk(p);
+    uint32_t stop = chunk.eq('*') & Chunk(p + 1).eq('/');
+    line += newlinesBefore(chunk.eq('\n'), stop);
+    if (stop != 0)
+      return p + std::countr_zero(stop);
+    p += Chunk::SIZE;
+  }
+#endif
+  for (; p < end && !(*p == '*' && p + 1 < end && p[1] == '/'); p++)
+  {
+    if (*p == '\n')
+      line++;
+  }
+  return p;
+}
@@ -0,0 +1,81 @@
+#include "Source.h"
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define SOURCE_MMAP
+#endif
+
+Source::~Source()
+{
+#ifdef SOURCE_MMAP
+  if (mapped != nullptr)
+    munmap((void*)mapped, mappedSize);
+#endif
+}
+
+void Source::assign(std::string text)
+{
+  this->text = std::move(text);
+}
+
+bool Source::load(const char* path)
+{
+#ifdef SOURCE_MMAP
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  /* pipes and such have no size to map, an empty file can't be mapped */
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+  {
+    close(fd);
+    return read(path);
+  }
+  /*
+   * the lexer reads every byte once, faulting the pages in one at a time
+   * as it goes costs more than having them all mapped up front
+   */
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  flags |= MAP_POPULATE;
+#endif
+  void* data = mmap(nullptr, info.st_size, PROT_READ, flags, fd, 0);
+  /* the mapping stays valid without the descriptor */
+  close(fd);
+  if (data == MAP_FAILED)
+    return read(path);
+  mapped = (const char*)data;
+  mappedSize = info.st_size;
+  return true;
+#else
+  return read(path);
+#endif
+}
+
+/* the whole file straight into text, one copy */
+bool Source::read(const char* path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  if (size > 0)
+  {
+    text.resize(size);
+    file.seekg(0);
+    file.read(text.data(), size);
+    text.resize(file.gcount());
+    return true;
+  }
+  /* no size to go by */
+  file.clear();
+  file.seekg(0);
+  text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/*
+ * The text of one program. A script file is mapped into memory and
+ * lexed right where it is, no copy of it is ever made. The REPL's lines,
+ * the web build's input and files that can't be mapped (not a regular
+ * file, no mmap on the platform) are kept in a string instead.
+ */
+class Source
+{
+public:
+  Source() = default;
+  ~Source();
+  Source(const Source&) = delete;
+  Source& operator=(const Source&) = delete;
+
+  void assign(std::string text);
+  /* false if path can't be opened */
+  bool load(const char* path);
+
+  std::string_view view() const
+  {
+    return mapped != nullptr ? std::string_view(mapped, mappedSize) : std::string_view(text);
+  }
+
+  size_t size() const
+  {
+    return view().size();
+  }
+
+  bool isMapped() const
+  {
+    return mapped != nullptr;
+  }
+private:
+  bool read(const char* path);
+
+  std::string text;
+  const char* mapped = nullptr;
+  size_t mappedSize = 0;
+};
@@ -0,0 +1,53 @@
+#include "Stats.h"
+#include "Memory.h"
+#include <cstdlib>
+#include <new>
+
+/* zero initialized before any constructor runs, so counting in operator new is safe */
+thread_local constinit Stats stats{};
+
+void printStats(std::ostream& os)
+{
+  os << "calls:                   " << stats.calls << std::endl;
+  os << "  native:                " << stats.nativeCalls << " (" << stats.jitFunctions << " functions compiled, "
+     << stats.jitBailouts << " bailouts)" << std::endl;
+  os << "  inlined:               " << stats.inlinedCalls << std::endl;
+  os << "  call cache:            " << stats.callCacheHits << " hits, " << stats.callCacheMisses << " misses" << std::endl;
+  os << "specialized nodes:       " << stats.specializations << " (" << stats.deoptimizations << " went back to generic)" << std::endl;
+  os << "counted loops:           " << stats.countedLoops << " (" << stats.countedIterations << " iterations)" << std::endl;
+  os << "gc:                      " << stats.gcCollections << " collections, " << stats.gcFreed << " objects freed" << std::endl;
+  os << "ast nodes:               " << stats.astNodes << " (" << stats.astBytes << " bytes, "
+     << (stats.astNodes ? stats.astBytes / stats.astNodes : 0) << " per node)" << std::endl;
+  os << "tokens:                  " << stats.tokens << " from " << stats.sourceBytes << " bytes ("
+     << (stats.lexNanos ? stats.tokens * 1e3 / stats.lexNanos : 0) << "M per second, "
+     << (stats.lexNanos ? stats.sourceBytes * 1e3 / stats.lexNanos : 0) << " MB/s)" << std::endl;
+  os << "program cache:           " << stats.cacheHits << " hits, " << stats.cacheMisses << " misses" << std::endl;
+  os << "time (ms):               load " << stats.loadNanos / 1e6 << ", cache " << stats.cacheNanos / 1e6 << ", lex " << stats.lexNanos / 1e6 << ", parse " << stats.parseNanos / 1e6 << ", resolve " << stats.resolveNanos / 1e6
+     << ", run " << stats.runNanos / 1e6 << std::endl;
+  os << "allocations:             " << stats.allocations << " (" << stats.allocatedBytes << " bytes)" << std::endl;
+  os << "  while interpreting:    " << stats.interpreterAllocations << std::endl;
+  os << "script memory:           peak " << memory.getPeak() << " bytes, ";
+  if (memory.getLimit() != 0)
+    os << "limit " << memory.getLimit() << std::endl;
+  else
+    os << "no limit" << std::endl;
+}
+
+void* operator new(std::size_t size)
+{
+  stats.allocations++;
+  stats.allocatedBytes += size;
+  if (void* ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
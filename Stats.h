@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+/* counters printed by --stats, cheap enough to always keep */
+struct Stats
+{
+  /* every operator new in the process */
+  uint64_t allocations;
+  uint64_t allocatedBytes;
+  /* the part of allocations that happened inside Interpreter::interpret */
+  uint64_t interpreterAllocations;
+  uint64_t calls;
+  /* the part of calls that ran as native code, see Jit.h */
+  uint64_t nativeCalls;
+  uint64_t jitFunctions;
+  uint64_t jitBailouts;
+  /* Call sites that went to the same function as last time, see CallCache */
+  uint64_t callCacheHits;
+  uint64_t callCacheMisses;
+  /* the part of calls the tree walker inlined, see Inliner.h */
+  uint64_t inlinedCalls;
+  /* Binary/Unary/Logical nodes the tree walker specialized, see Specialization */
+  uint64_t specializations;
+  uint64_t deoptimizations;
+  /* while loops the tree walker ran on a plain double, see CountedLoop */
+  uint64_t countedLoops;
+  uint64_t countedIterations;
+  /* cycle collections and the closures and cells they freed, see Heap.h */
+  uint64_t gcCollections;
+  uint64_t gcFreed;
+  /* AST nodes and the Arena bytes they took, see Program.h */
+  uint64_t astNodes;
+  uint64_t astBytes;
+  uint64_t tokens;
+  uint64_t sourceBytes;
+  /* scripts whose AST came out of the program cache or didn't, see ProgramCache.h */
+  uint64_t cacheHits;
+  uint64_t cacheMisses;
+  /*
+   * reading the script file in, looking it up in and writing it to the
+   * program cache, then run(): lexing, parsing (and --optimize), resolving,
+   * running
+   */
+  uint64_t loadNanos;
+  uint64_t cacheNanos;
+  uint64_t lexNanos;
+  uint64_t parseNanos;
+  uint64_t resolveNanos;
+  uint64_t runNanos;
+};
+
+/*
+ * one per thread, so operator new can count without locking. the
+ * parallel front end's workers add theirs to the main thread's when
+ * they're done (FrontEnd.cpp), everything else runs on the main thread
+ */
+extern thread_local constinit Stats stats;
+
+void printStats(std::ostream& os);
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <memory>
-#include <any>
+#include "Value.h"
 #include <string>
 #include "Expr.h"
 #include "Environment.h"
@@ -17,6 +17,27 @@ class Expression;
 class Print;
 class Var;
 class While;
+struct Chunk;
+struct CompiledStmt;
+
+/*
+ * What running a statement did. return/break/continue propagate up
+ * through blocks, ifs and loops as a value instead of a C++ throw, until
+ * the loop or call that handles them.
+ */
+enum CompletionType
+{
+	COMPLETION_NORMAL, COMPLETION_RETURN, COMPLETION_BREAK, COMPLETION_CONTINUE,
+	/* return f(...); the args are on top of the stack, see Interpreter::executeFunction */
+	COMPLETION_TAIL_CALL
+};
+
+struct Completion
+{
+	CompletionType type = COMPLETION_NORMAL;
+	/* the returned value for COMPLETION_RETURN, the callee for COMPLETION_TAIL_CALL */
+	Value value;
+};
 
 template <typename T>
 class StmtVisitor
@@ -37,101 +58,239 @@ public:
 class Stmt
 {
 public:
-	virtual std::any accept(StmtVisitor<std::any>& visitor) = 0;
+	virtual ~Stmt() = default;
+	virtual Completion accept(StmtVisitor<Completion>& visitor) = 0;
+
+	/* in the program's Arena, see Arena.h */
+	static void* operator new(size_t size)
+	{
+		return Arena::allocateNode(size);
+	}
+
+	static void operator delete(void* ptr) {}
 };
 
 class Return : public Stmt
 {
 public:
 	Return(const Token& token, std::unique_ptr<Expr> value)
-		: token(token),
+		: token(&token),
 			value(std::move(value))
 	{}
 
-	std::any accept(StmtVisitor<std::any>& visitor) override
+	Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitReturnStmt(*this);
 	}
 
 	const Token& getToken()
 	{
-		return token;
+		return *token;
 	}
 
 	Expr& getValue()
 	{
 		return *value;
 	}
+
+	/* set by the Resolver when the value is a Call in a function */
+	void setTailCall(bool tailCall)
+	{
+		this->tailCall = tailCall;
+	}
+
+	bool isTailCall()
+	{
+		return tailCall;
+	}
 private:
-	Token token;
+	friend class Optimizer;
+	const Token* token;
 	std::unique_ptr<Expr> value;
+	bool tailCall = false;
+};
+
+
+/* where a Var/Function stores its variable, filled in by the Resolver */
+struct VarDecl
+{
+	bool global = false;  /* slot is in the global table, not the frame */
+	int slot = -1;
+	bool boxed = false;   /* captured by a closure, the slot holds a Cell */
+};
+
+/* a captured variable, copied into the closure when it's created */
+struct Capture
+{
+	bool isLocal;   /* slot in the enclosing frame, otherwise an enclosing upvalue */
+	int index;
 };
 
+/* what the tree walker's inliner made of a function, see Inliner.h */
+struct InlineInfo
+{
+	bool tried = false;
+	/* the body's only statement if it's small enough to inline, else null */
+	Stmt* body = nullptr;
+	/* its value if that statement is a return */
+	Expr* value = nullptr;
+	/* the globals the body calls, it isn't inlined where it's called through one of them */
+	std::vector<int> calls;
+};
+
+/* what the JIT made of a function, see Jit.h */
+struct JitInfo
+{
+	/* only compile once, code stays null when the function can't be compiled */
+	bool tried = false;
+	void* code = nullptr;
+	int bailouts = 0;
+};
+
+/*
+ * The callable part of a Function statement or a Lambda expression,
+ * plus the frame layout the Resolver worked out for it.
+ */
+class FunctionInfo
+{
+public:
+	FunctionInfo(std::vector<const Token*> params, std::vector<std::unique_ptr<Stmt>> body)
+		: params(std::move(params)), body(std::move(body))
+	{}
+
+	const std::vector<const Token*>& getParams()
+	{
+		return params;
+	}
+
+	const std::vector<std::unique_ptr<Stmt>>& getBody()
+	{
+		return body;
+	}
+
+	int getArity()
+	{
+		return params.size();
+	}
+
+	/* params are slots 0..arity-1, then every local in the body */
+	int slotCount = 0;
+	std::vector<Capture> captures;
+	std::vector<int> boxedParams;
+	/* the body compiled for the VM, owned by it */
+	Chunk* chunk = nullptr;
+	/* the body compiled by the closure engine, owned by it */
+	CompiledStmt* compiled = nullptr;
+	JitInfo jit;
+	InlineInfo inlining;
+private:
+	friend class Optimizer;
+	std::vector<const Token*> params;
+	std::vector<std::unique_ptr<Stmt>> body;
+};
 
 class Function : public Stmt
 {
 public:
-	Function(const Token& name, std::vector<Token> params, std::vector<std::unique_ptr<Stmt>> body)
-  : name(name), params(params), body(std::move(body))
+	Function(const Token& name, std::vector<const Token*> params, std::vector<std::unique_ptr<Stmt>> body)
+  : name(&name), info(std::move(params), std::move(body))
   {}
 
-  std::any accept(StmtVisitor<std::any>& visitor) override
+  Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitFunctionStmt(*this);
 	}
 
   const Token& getName()
 	{
-		return name;
+		return *name;
 	}
 
-	const std::vector<Token>& getParams()
+	const std::vector<const Token*>& getParams()
 	{
-		return params;
+		return info.getParams();
 	}
 
 	const std::vector<std::unique_ptr<Stmt>>& getBody()
 	{
-		return body;
+		return info.getBody();
+	}
+
+	FunctionInfo& getInfo()
+	{
+		return info;
+	}
+
+	VarDecl& getDecl()
+	{
+		return decl;
 	}
 private:
-  Token name;
-  std::vector<Token> params;
-  std::vector<std::unique_ptr<Stmt>> body;
+  const Token* name;
+  FunctionInfo info;
+  VarDecl decl;
 };
 
 class Break : public Stmt
 {
 public:
-  std::any accept(StmtVisitor<std::any>& visitor) override
+	Break(const Token& keyword)
+		: keyword(&keyword)
+	{}
+
+  Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitBreakStmt(*this);
 	}
+
+	const Token& getKeyword()
+	{
+		return *keyword;
+	}
+private:
+	const Token* keyword;
 };
 
 class Continue : public Stmt
 {
 public:
-  std::any accept(StmtVisitor<std::any>& visitor) override
+	Continue(const Token& keyword)
+		: keyword(&keyword)
+	{}
+
+  Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitContinueStmt(*this);
 	}
+
+	const Token& getKeyword()
+	{
+		return *keyword;
+	}
+private:
+	const Token* keyword;
 };
 
 class If : public Stmt
 {
 public:
-	If(std::unique_ptr<Expr> condition, std::unique_ptr<Stmt> thenBranch, std::unique_ptr<Stmt> elseBranch)
-		: condition(std::move(condition)),
+	If(const Token& keyword, std::unique_ptr<Expr> condition, std::unique_ptr<Stmt> thenBranch, std::unique_ptr<Stmt> elseBranch)
+		: keyword(&keyword),
+			condition(std::move(condition)),
 			thenBranch(std::move(thenBranch)),
 			elseBranch(std::move(elseBranch))
 	{}
 
-	std::any accept(StmtVisitor<std::any>& visitor) override
+	Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitIfStmt(*this);
 	}
 
+	const Token& getKeyword()
+	{
+		return *keyword;
+	}
+
 	Expr& getCondition()
 	{
 		return *condition;
@@ -152,6 +311,8 @@ public:
     return (elseBranch != nullptr);
   }
 private:
+	friend class Optimizer;
+	const Token* keyword;
 	std::unique_ptr<Expr> condition;
 	std::unique_ptr<Stmt> thenBranch;
 	std::unique_ptr<Stmt> elseBranch;
@@ -165,7 +326,7 @@ public:
 		: statements(std::move(statements))
 	{}
 
-	std::any accept(StmtVisitor<std::any>& visitor) override
+	Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitBlockStmt(*this);
 	}
@@ -175,6 +336,7 @@ public:
 		return statements;
 	}
 private:
+	friend class Optimizer;
 	std::vector<std::unique_ptr<Stmt>> statements;
 };
 
@@ -186,7 +348,7 @@ public:
 		: expression(std::move(expression))
 	{}
 
-	std::any accept(StmtVisitor<std::any>& visitor) override
+	Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitExpressionStmt(*this);
 	}
@@ -197,6 +359,7 @@ public:
 	}
 
 private:
+	friend class Optimizer;
 	std::unique_ptr<Expr> expression;
 };
 
@@ -207,7 +370,7 @@ public:
 		: expression(std::move(expression))
 	{}
 
-	std::any accept(StmtVisitor<std::any>& visitor) override
+	Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitPrintStmt(*this);
 	}
@@ -218,6 +381,7 @@ public:
 	}
 
 private:
+	friend class Optimizer;
 	std::unique_ptr<Expr> expression;
 };
 
@@ -225,17 +389,17 @@ class Var : public Stmt
 {
 public:
 	Var(const Token& name, std::unique_ptr<Expr> initializer)
-		: name(name), initializer(std::move(initializer))
+		: name(&name), initializer(std::move(initializer))
 	{}
 
-	std::any accept(StmtVisitor<std::any>& visitor) override
+	Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitVarStmt(*this);
 	}
 
-	Token getName()
+	const Token& getName()
 	{
-		return name;
+		return *name;
 	}
 
 	Expr& getInitializer()
@@ -248,9 +412,37 @@ public:
     return (initializer != nullptr);
   }
 
+	VarDecl& getDecl()
+	{
+		return decl;
+	}
+
 private:
-	Token name;
+	friend class Optimizer;
+	const Token* name;
 	std::unique_ptr<Expr> initializer;
+	VarDecl decl;
+};
+
+/*
+ * A while loop (or a for, after the Parser desugared it) shaped like
+ *   while (i < bound) { ...; i = i + step; }
+ * that nothing else in the body can change i or bound in, see
+ * CountedLoop.h. The tree walker works this out on the loop's first run
+ * and then counts in a double instead of evaluating the condition and
+ * the increment as expressions.
+ */
+struct CountedLoop
+{
+	enum State : uint8_t { UNSEEN, COUNTED, GENERIC };
+	State state = UNSEEN;
+	TokenType op = LESS;
+	VarRef counter;
+	/* bound is a number literal or a variable read once before the loop */
+	bool boundIsLiteral = false;
+	double boundValue = 0;
+	VarRef boundVar;
+	double step = 0;
 };
 
 class While : public Stmt
@@ -261,7 +453,7 @@ public:
 			body(std::move(body))
 	{}
 
-	std::any accept(StmtVisitor<std::any>& visitor) override
+	Completion accept(StmtVisitor<Completion>& visitor) override
 	{
 		return visitor.visitWhileStmt(*this);
 	}
@@ -275,33 +467,44 @@ public:
 	{
 		return *body;
 	}
+
+	CountedLoop& getCountedLoop()
+	{
+		return counted;
+	}
 private:
+	friend class Optimizer;
 	std::unique_ptr<Expr> condition;
 	std::unique_ptr<Stmt> body;
+	CountedLoop counted;
 };
 
 class Lambda : public Expr
 {
 public:
-	Lambda(std::vector<Token> params, std::vector<std::unique_ptr<Stmt>> body)
-		: params(params), body(std::move(body))
+	Lambda(std::vector<const Token*> params, std::vector<std::unique_ptr<Stmt>> body)
+		: info(std::move(params), std::move(body))
 	{}
 
-	std::any accept(ExprVisitor<std::any>& visitor) override
+	Value accept(ExprVisitor<Value>& visitor) override
 	{
 		return visitor.visitLambdaExpr(*this);
 	}
 
-	const std::vector<Token>& getParams()
+	const std::vector<const Token*>& getParams()
 	{
-		return params;
+		return info.getParams();
 	}
 
 	const std::vector<std::unique_ptr<Stmt>>& getBody()
 	{
-		return body;
+		return info.getBody();
+	}
+
+	FunctionInfo& getInfo()
+	{
+		return info;
 	}
 private:
-	std::vector<Token> params;
-	std::vector<std::unique_ptr<Stmt>> body;
-};
\ No newline at end of file
+	FunctionInfo info;
+};
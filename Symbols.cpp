@@ -0,0 +1,50 @@
+#include "Symbols.h"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+/* a deque so the strings the map's keys point into never move */
+static std::deque<std::string>& names()
+{
+  static std::deque<std::string> names;
+  return names;
+}
+
+static std::unordered_map<std::string_view, Symbol>& symbols()
+{
+  static std::unordered_map<std::string_view, Symbol> symbols;
+  return symbols;
+}
+
+Symbol Symbols::intern(std::string_view name)
+{
+  auto it = symbols().find(name);
+  if (it != symbols().end())
+    return it->second;
+
+  Symbol symbol = names().size();
+  names().emplace_back(name);
+  symbols().emplace(names().back(), symbol);
+  return symbol;
+}
+
+const std::string& Symbols::name(Symbol symbol)
+{
+  return names()[symbol];
+}
+
+size_t Symbols::count()
+{
+  return names().size();
+}
+
+std::vector<Symbol> LocalSymbols::publish()
+{
+  static std::mutex lock;
+  std::lock_guard<std::mutex> guard(lock);
+  std::vector<Symbol> published;
+  published.reserve(names.size());
+  for (std::string_view name : names)
+    published.push_back(Symbols::intern(name));
+  return published;
+}
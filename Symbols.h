@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/* an interned identifier, the same name is the same Symbol in every program run */
+using Symbol = uint32_t;
+
+/*
+ * The table the Lexer interns identifiers in, so the Resolver and the
+ * global table compare and look up numbers instead of strings. Lives as
+ * long as the process, names are only ever added.
+ */
+class Symbols
+{
+public:
+  /* not while the front end's threads run, they go through LocalSymbols */
+  static Symbol intern(std::string_view name);
+  static const std::string& name(Symbol symbol);
+  static size_t count();
+};
+
+/*
+ * Interning for a Lexer on one of the front end's threads (FrontEnd.h).
+ * Its tokens get numbers that only mean something here, publish() interns
+ * the names in Symbols, one thread at a time, and says which Symbol each
+ * number turned into.
+ */
+class LocalSymbols
+{
+public:
+  Symbol intern(std::string_view name)
+  {
+    auto it = symbols.try_emplace(name, (Symbol)names.size());
+    if (it.second)
+      names.push_back(name);
+    return it.first->second;
+  }
+
+  std::vector<Symbol> publish();
+private:
+  /* point into the source, the Lexer's tokens do too */
+  std::vector<std::string_view> names;
+  std::unordered_map<std::string_view, Symbol> symbols;
+};
@@ -1,7 +1,8 @@
 #pragma once
-#include <string>
+#include <string_view>
 #include <ostream>
-#include <any>
+#include <variant>
+#include "Symbols.h"
 
 enum TokenType {
   LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE,
@@ -21,24 +22,51 @@ enum TokenType {
   _EOF_
 };
 
+/*
+ * lexeme points into the source, which the Program keeps around for as
+ * long as its tokens (see Program.h). lit is the value of a NUMBER and
+ * the interned name of an IDENTIFIER, a STRING's value is its lexeme
+ * without the quotes.
+ */
 class Token
 {
 public:
   TokenType type;
-  std::string lexeme;
-  std::any lit;
   int line;
+  std::string_view lexeme;
+  std::variant<std::monostate, double, Symbol> lit;
 public:
-  Token(TokenType type, std::string lexeme, std::any lit, int line)
-    : type(type), lexeme(lexeme), lit(lit), line(line)
+  Token(TokenType type, std::string_view lexeme, int line)
+    : type(type), line(line), lexeme(lexeme)
   {}
 
+  Token(TokenType type, std::string_view lexeme, std::variant<std::monostate, double, Symbol> lit, int line)
+    : type(type), line(line), lexeme(lexeme), lit(lit)
+  {}
+
+  double number() const
+  {
+    return std::get<double>(lit);
+  }
+
+  Symbol symbol() const
+  {
+    return std::get<Symbol>(lit);
+  }
+
+  std::string_view string() const
+  {
+    return lexeme.substr(1, lexeme.size() - 2);
+  }
+
   friend std::ostream& operator << (std::ostream& os, const Token& token) {
     os << "Line: " << token.line << " [" << token.type << "]" << " " << token.lexeme;
     if (token.type == NUMBER)
-      os << " num: " << std::any_cast<double>(token.lit);
+      os << " num: " << token.number();
     else if (token.type == STRING)
-      os << " str: " << std::any_cast<std::string>(token.lit);
+      os << " str: " << token.string();
+    else if (token.type == IDENTIFIER)
+      os << " sym: " << token.symbol();
     return os;
   }
 };
@@ -0,0 +1,400 @@
+#include "VM.h"
+#include "Callable.h"
+#include "Compiler.h"
+#include "Stats.h"
+#include <new>
+#include <utility>
+
+VM::VM()
+  : stack(STACK_SIZE), frames(MAX_CALL_DEPTH + 1)
+{
+  stackTop = stack.data();
+}
+
+void VM::interpret(std::unique_ptr<Program> program, int slotCount)
+{
+  programs.push_back(std::move(program));
+  uint64_t allocations = stats.allocations;
+  memory.beginRun();
+  try
+  {
+    Compiler compiler(chunks);
+    Chunk* script = compiler.compile(programs.back()->statements);
+    if (slotCount + script->maxStack > STACK_SIZE)
+      throw std::make_pair(Token(_EOF_, "", {}, 0), std::string("Stack overflow."));
+
+    frames[0] = { nullptr, script, script->code.data(), stack.data() };
+    frameCount = 1;
+    stackTop = stack.data() + slotCount;
+    allocations = stats.allocations;
+    run();
+  }
+  catch (std::pair<Token, std::string>& tokStr)
+  {
+    reportError(tokStr.first, tokStr.second);
+  }
+  catch (MemoryLimitError& error)
+  {
+    reportError(memoryLimitMessage(error.limit));
+  }
+  popFrame(stack.data());
+  memory.endRun();
+  stats.interpreterAllocations += stats.allocations - allocations;
+}
+
+/* releases everything from base up and makes it the new top */
+void VM::popFrame(Value* base)
+{
+  while (stackTop > base)
+    *--stackTop = Value();
+}
+
+/* captured locals are boxed, but a slot whose declaration never ran isn't */
+static Value& cellValue(Value& slot)
+{
+  return slot.isCell() ? slot.asCell()->value : slot;
+}
+
+#define READ_OPERAND() (ip += 3, (uint32_t)(ip[-3] | ip[-2] << 8 | ip[-1] << 16))
+/* the token of the instruction that's running, only looked up when it's needed */
+#define TOKEN() chunk->tokenAt(ip - chunk->code.data() - 1)
+#define RUNTIME_ERROR(msg) throw std::make_pair(TOKEN(), std::string(msg))
+
+/*
+ * with GCC/clang every instruction jumps straight to the next one's
+ * handler instead of going back through the switch, one indirect jump
+ * per instruction that the branch predictor can tell apart
+ */
+#if defined(__GNUC__)
+#define COMPUTED_GOTO
+#endif
+
+#ifdef COMPUTED_GOTO
+#define CASE(op) case op: label_##op
+#define DISPATCH() goto *dispatchTable[*ip++]
+#else
+#define CASE(op) case op
+#define DISPATCH() break
+#endif
+
+/* nothing above sp holds an object, so pushing doesn't release anything */
+#define PUSH(value) new (sp++) Value(value)
+
+/* b is a number, so dropping it doesn't need a release */
+#define NUMBER_OP(op) \
+  { \
+    Value& a = sp[-2]; \
+    Value& b = sp[-1]; \
+    if (!a.isNumber() || !b.isNumber()) \
+      RUNTIME_ERROR("Operands must be numbers."); \
+    new (&a) Value(a.asNumber() op b.asNumber()); \
+    sp--; \
+    DISPATCH(); \
+  }
+
+void VM::run()
+{
+  CallFrame* frame = &frames[frameCount - 1];
+  Chunk* chunk = frame->chunk;
+  Callable* function = frame->function;
+  const uint8_t* ip = frame->ip;
+  Value* slots = frame->slots;
+  Value* sp = stackTop;
+  Value* stackEnd = stack.data() + stack.size();
+
+#ifdef COMPUTED_GOTO
+  /* same order as OpCode */
+  static void* dispatchTable[] = {
+    &&label_OP_CONSTANT, &&label_OP_NIL, &&label_OP_TRUE, &&label_OP_FALSE, &&label_OP_POP,
+    &&label_OP_GET_LOCAL, &&label_OP_SET_LOCAL, &&label_OP_DEFINE_LOCAL, &&label_OP_GET_CELL,
+    &&label_OP_SET_CELL, &&label_OP_DEFINE_CELL, &&label_OP_NEW_CELL, &&label_OP_GET_UPVALUE,
+    &&label_OP_SET_UPVALUE, &&label_OP_GET_GLOBAL, &&label_OP_SET_GLOBAL,
+    &&label_OP_STORE_GLOBAL, &&label_OP_DEFINE_GLOBAL, &&label_OP_EQUAL, &&label_OP_NOT_EQUAL,
+    &&label_OP_GREATER, &&label_OP_GREATER_EQUAL, &&label_OP_LESS, &&label_OP_LESS_EQUAL,
+    &&label_OP_ADD, &&label_OP_SUBTRACT, &&label_OP_MULTIPLY, &&label_OP_DIVIDE,
+    &&label_OP_NOT, &&label_OP_NEGATE, &&label_OP_PRINT, &&label_OP_JUMP,
+    &&label_OP_JUMP_IF_FALSE, &&label_OP_AND, &&label_OP_OR, &&label_OP_LOOP,
+    &&label_OP_CLOSURE, &&label_OP_CALL, &&label_OP_TAIL_CALL, &&label_OP_RETURN,
+    &&label_OP_RETURN_NIL
+  };
+  static_assert(sizeof(dispatchTable) / sizeof(*dispatchTable) == OP_RETURN_NIL + 1, "dispatchTable is missing an OpCode");
+#endif
+
+  try
+  {
+    for (;;)
+    {
+      switch (*ip++)
+      {
+      CASE(OP_CONSTANT):
+        PUSH(chunk->constants[READ_OPERAND()]);
+        DISPATCH();
+      CASE(OP_NIL):
+        PUSH(Value());
+        DISPATCH();
+      CASE(OP_TRUE):
+        PUSH(Value(true));
+        DISPATCH();
+      CASE(OP_FALSE):
+        PUSH(Value(false));
+        DISPATCH();
+      CASE(OP_POP):
+        *--sp = Value();
+        DISPATCH();
+
+      CASE(OP_GET_LOCAL):
+        PUSH(slots[READ_OPERAND()]);
+        DISPATCH();
+      CASE(OP_SET_LOCAL):
+        slots[READ_OPERAND()] = sp[-1];
+        DISPATCH();
+      CASE(OP_DEFINE_LOCAL):
+        slots[READ_OPERAND()] = std::move(*--sp);
+        DISPATCH();
+      CASE(OP_GET_CELL):
+        PUSH(cellValue(slots[READ_OPERAND()]));
+        DISPATCH();
+      CASE(OP_SET_CELL):
+        cellValue(slots[READ_OPERAND()]) = sp[-1];
+        DISPATCH();
+      CASE(OP_DEFINE_CELL):
+      {
+        Value& slot = slots[READ_OPERAND()];
+        slot = Value(new Cell(std::move(*--sp)));
+        DISPATCH();
+      }
+      CASE(OP_NEW_CELL):
+      {
+        Value& slot = slots[READ_OPERAND()];
+        slot = Value(new Cell(Value()));
+        DISPATCH();
+      }
+      CASE(OP_GET_UPVALUE):
+        PUSH(function->getUpvalue(READ_OPERAND())->value);
+        DISPATCH();
+      CASE(OP_SET_UPVALUE):
+        function->getUpvalue(READ_OPERAND())->value = sp[-1];
+        DISPATCH();
+      CASE(OP_GET_GLOBAL):
+      {
+        const Value& value = globals.at(READ_OPERAND());
+        if (value.isUndefined())
+          globals.undefined(TOKEN());
+        PUSH(value);
+        DISPATCH();
+      }
+      CASE(OP_SET_GLOBAL):
+      {
+        Value& value = globals.at(READ_OPERAND());
+        if (value.isUndefined())
+          globals.undefined(TOKEN());
+        value = sp[-1];
+        DISPATCH();
+      }
+      CASE(OP_STORE_GLOBAL):
+      {
+        Value& value = globals.at(READ_OPERAND());
+        if (value.isUndefined())
+          globals.undefined(TOKEN());
+        value = std::move(*--sp);
+        DISPATCH();
+      }
+      CASE(OP_DEFINE_GLOBAL):
+      {
+        int slot = READ_OPERAND();
+        globals.define(slot, std::move(*--sp));
+        DISPATCH();
+      }
+
+      CASE(OP_EQUAL):
+      CASE(OP_NOT_EQUAL):
+      {
+        bool equal = isEqual(sp[-2], sp[-1]);
+        *--sp = Value();
+        sp[-1] = Value(ip[-1] == OP_EQUAL ? equal : !equal);
+        DISPATCH();
+      }
+      CASE(OP_GREATER):       NUMBER_OP(>)
+      CASE(OP_GREATER_EQUAL): NUMBER_OP(>=)
+      CASE(OP_LESS):          NUMBER_OP(<)
+      CASE(OP_LESS_EQUAL):    NUMBER_OP(<=)
+      CASE(OP_SUBTRACT):      NUMBER_OP(-)
+      CASE(OP_MULTIPLY):      NUMBER_OP(*)
+      CASE(OP_DIVIDE):
+        if (sp[-1].isNumber() && sp[-1].asNumber() == 0 && sp[-2].isNumber())
+          RUNTIME_ERROR("Check your math big man!! you cant divide a number by 0");
+        NUMBER_OP(/)
+      CASE(OP_ADD):
+      {
+        Value& a = sp[-2];
+        Value& b = sp[-1];
+        if (a.isNumber() && b.isNumber())
+        {
+          new (&a) Value(a.asNumber() + b.asNumber());
+          sp--;
+          DISPATCH();
+        }
+        a = addValues(TOKEN(), a, b);
+        *--sp = Value();
+        DISPATCH();
+      }
+      CASE(OP_NOT):
+        sp[-1] = Value(!isTruthy(sp[-1]));
+        DISPATCH();
+      CASE(OP_NEGATE):
+        if (!sp[-1].isNumber())
+          RUNTIME_ERROR("Operand must be a number.");
+        sp[-1] = Value(-sp[-1].asNumber());
+        DISPATCH();
+
+      CASE(OP_PRINT):
+        print(sp[-1]);
+        *--sp = Value();
+        DISPATCH();
+      CASE(OP_JUMP):
+      {
+        uint32_t jump = READ_OPERAND();
+        ip += jump;
+        DISPATCH();
+      }
+      CASE(OP_JUMP_IF_FALSE):
+      {
+        uint32_t jump = READ_OPERAND();
+        if (!isTruthy(sp[-1]))
+          ip += jump;
+        *--sp = Value();
+        DISPATCH();
+      }
+      CASE(OP_AND):
+      {
+        uint32_t jump = READ_OPERAND();
+        if (!isTruthy(sp[-1]))
+          ip += jump;
+        else
+          *--sp = Value();
+        DISPATCH();
+      }
+      CASE(OP_OR):
+      {
+        uint32_t jump = READ_OPERAND();
+        if (isTruthy(sp[-1]))
+          ip += jump;
+        else
+          *--sp = Value();
+        DISPATCH();
+      }
+      CASE(OP_LOOP):
+      {
+        uint32_t jump = READ_OPERAND();
+        ip -= jump;
+        DISPATCH();
+      }
+
+      CASE(OP_CLOSURE):
+      {
+        auto& closure = chunk->functions[READ_OPERAND()];
+        PUSH(Callable::closure(*closure.first, closure.second, slots, function));
+        DISPATCH();
+      }
+      CASE(OP_CALL):
+      {
+        int argCount = READ_OPERAND();
+        Value* args = sp - argCount;
+        if (!args[-1].isCallable())
+          RUNTIME_ERROR("Object called is not a function");
+        Callable* callee = args[-1].asCallable();
+        if (argCount != callee->getArity())
+          RUNTIME_ERROR("Invalid number of arguments");
+        FunctionInfo& info = callee->getInfo();
+        if (frameCount > MAX_CALL_DEPTH || stackEnd - args < info.slotCount + info.chunk->maxStack)
+          RUNTIME_ERROR("Stack overflow.");
+        if (!memory.fitsFrame(frameBytes(info)))
+          RUNTIME_ERROR(memoryLimitMessage(memory.getLimit()));
+        memory.pushFrame(frameBytes(info));
+        stats.calls++;
+
+        frame->ip = ip;
+        frame = &frames[frameCount++];
+        frame->function = function = callee;
+        frame->chunk = chunk = info.chunk;
+        frame->slots = slots = args;
+        ip = chunk->code.data();
+        /* the slots above the args can hold stale numbers, locals start out nil */
+        sp = args + info.slotCount;
+        for (Value* local = args + argCount; local < sp; local++)
+          *local = Value();
+        for (int slot : info.boxedParams)
+          slots[slot] = Value(new Cell(slots[slot]));
+        DISPATCH();
+      }
+      CASE(OP_TAIL_CALL):
+      {
+        /* same checks as OP_CALL, but the callee and args replace the running frame */
+        int argCount = READ_OPERAND();
+        Value* args = sp - argCount;
+        if (!args[-1].isCallable())
+          RUNTIME_ERROR("Object called is not a function");
+        Callable* callee = args[-1].asCallable();
+        if (argCount != callee->getArity())
+          RUNTIME_ERROR("Invalid number of arguments");
+        FunctionInfo& info = callee->getInfo();
+        if (stackEnd - slots < info.slotCount + info.chunk->maxStack)
+          RUNTIME_ERROR("Stack overflow.");
+        if (!memory.fitsFrame(frameBytes(info)))
+          RUNTIME_ERROR(memoryLimitMessage(memory.getLimit()));
+        /* before the move below, it can free the function that was running */
+        memory.popFrame(frameBytes(function->getInfo()));
+        memory.pushFrame(frameBytes(info));
+        stats.calls++;
+
+        slots[-1] = std::move(args[-1]);
+        for (int i = 0; i < argCount; i++)
+          slots[i] = std::move(args[i]);
+        Value* top = std::max(sp, slots + info.slotCount);
+        for (Value* local = slots + argCount; local < top; local++)
+          *local = Value();
+
+        frame->function = function = callee;
+        frame->chunk = chunk = info.chunk;
+        ip = chunk->code.data();
+        sp = slots + info.slotCount;
+        for (int slot : info.boxedParams)
+          slots[slot] = Value(new Cell(slots[slot]));
+        DISPATCH();
+      }
+      CASE(OP_RETURN):
+      CASE(OP_RETURN_NIL):
+      {
+        if (frameCount == 1)
+        {
+          /* end of the script */
+          stackTop = sp;
+          return;
+        }
+
+        Value result;
+        if (ip[-1] == OP_RETURN)
+          result = std::move(sp[-1]);
+        memory.popFrame(frameBytes(function->getInfo()));
+        /* the callee is right below the frame */
+        while (sp > slots - 1)
+          *--sp = Value();
+
+        frame = &frames[--frameCount - 1];
+        function = frame->function;
+        chunk = frame->chunk;
+        ip = frame->ip;
+        slots = frame->slots;
+        PUSH(std::move(result));
+        DISPATCH();
+      }
+      }
+    }
+  }
+  catch (...)
+  {
+    /* so interpret() can release what's on the stack */
+    stackTop = sp;
+    throw;
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Engine.h"
+#include "Chunk.h"
+
+class Callable;
+
+/*
+ * Stack based bytecode VM (--engine=vm). interpret() compiles the
+ * resolved program with the Compiler and runs it. Frames use the same
+ * slot layout as the tree walker, a call's frame starts at its first
+ * argument with the callee right below it, and expression temporaries
+ * go on top of the locals. Calls don't recurse in C++.
+ */
+class VM : public Engine
+{
+public:
+	VM();
+	void interpret(std::unique_ptr<Program> program, int slotCount) override;
+private:
+	struct CallFrame
+	{
+		/* null for the top-level script */
+		Callable* function;
+		Chunk* chunk;
+		/* where to carry on once the call this frame made returns */
+		const uint8_t* ip;
+		Value* slots;
+	};
+
+	void run();
+	void popFrame(Value* base);
+private:
+	/* every chunk ever compiled, closures point at them */
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	/* slots above stackTop never hold an object */
+	std::vector<Value> stack;
+	Value* stackTop;
+	std::vector<CallFrame> frames;
+	int frameCount = 0;
+};
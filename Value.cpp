@@ -0,0 +1,123 @@
+#include "Value.h"
+#include "Callable.h"
+#include "Heap.h"
+#include <vector>
+
+/* results up to this size are copied flat instead of making a node */
+static constexpr size_t FLAT_CONCAT_LIMIT = 32;
+/* appending to a node whose right leaf is smaller than this rebuilds the leaf */
+static constexpr size_t ROPE_LEAF_LIMIT = 256;
+
+void freeObject(Object* object)
+{
+  switch (object->type)
+  {
+  case VAL_STRING:
+    String::destroy(static_cast<String*>(object));
+    break;
+  case VAL_CALLABLE:
+    heap.untrack(object);
+    delete static_cast<Callable*>(object);
+    break;
+  case VAL_CELL:
+    heap.untrack(object);
+    delete static_cast<Cell*>(object);
+    break;
+  default:
+    break;
+  }
+}
+
+String::String(String* left, String* right)
+  : Object(VAL_STRING), length(left->length + right->length), left(left), right(right)
+{
+  /* before taking the refs, a throw here must leave left and right alone */
+  memory.checkLength(length);
+  memory.charge(sizeof(String));
+  left->refs++;
+  right->refs++;
+}
+
+String* String::concat(String* left, String* right)
+{
+  if (left->length == 0)
+    return right;
+  if (right->length == 0)
+    return left;
+
+  if (left->length + right->length <= FLAT_CONCAT_LIMIT)
+    return new String(left->getChars() + right->getChars());
+
+  /*
+   * s = s + "x" over and over would give one node per append, so
+   * keep growing a small right-hand leaf instead. the old leaf is shared
+   * with the previous string so it gets copied, but it's bounded in size.
+   * not for s + s, getting right's chars would flatten left under us
+   */
+  if (left != right && !left->isFlat() && left->right->isFlat() &&
+      left->right->length + right->length <= ROPE_LEAF_LIMIT)
+  {
+    /* held so it's freed if the node goes over the memory limit */
+    Value leaf = Value(new String(left->right->chars + right->getChars()));
+    return new String(left->left, leaf.asString());
+  }
+
+  return new String(left, right);
+}
+
+void String::flatten()
+{
+  memory.charge(length);
+  std::string flat;
+  flat.reserve(length);
+
+  /* ropes built in a loop are thousands of levels deep, so no recursion */
+  std::vector<String*> stack{this};
+  while (!stack.empty())
+  {
+    String* node = stack.back();
+    stack.pop_back();
+    if (node->isFlat())
+    {
+      flat += node->chars;
+      continue;
+    }
+    stack.push_back(node->right);
+    stack.push_back(node->left);
+  }
+
+  String* oldLeft = left;
+  String* oldRight = right;
+  chars = std::move(flat);
+  left = nullptr;
+  right = nullptr;
+  if (--oldLeft->refs == 0)
+    destroy(oldLeft);
+  if (--oldRight->refs == 0)
+    destroy(oldRight);
+}
+
+void String::destroy(String* string)
+{
+  if (string->isFlat())
+  {
+    delete string;
+    return;
+  }
+
+  /* same as flatten, deleting a deep rope recursively blows the stack */
+  std::vector<String*> dead{string};
+  while (!dead.empty())
+  {
+    String* node = dead.back();
+    dead.pop_back();
+    if (!node->isFlat())
+    {
+      if (--node->left->refs == 0)
+        dead.push_back(node->left);
+      if (--node->right->refs == 0)
+        dead.push_back(node->right);
+    }
+    delete node;
+  }
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "Memory.h"
+
+class Callable;
+class Cell;
+
+enum ValueType : uint8_t
+{
+  VAL_NIL, VAL_BOOL, VAL_NUMBER,
+  /* never seen by scripts, a global slot whose var hasn't run yet */
+  VAL_UNDEFINED,
+  /* everything from here on points at an Object */
+  VAL_STRING, VAL_CALLABLE,
+  /* never seen by scripts, a frame slot holding a captured local */
+  VAL_CELL
+};
+
+/*
+ * Header shared by everything that lives on the heap. Objects are
+ * reference counted by the Values that point at them and freed by
+ * freeObject() once the last one goes away. Closures and cells can
+ * point at each other in a cycle that counting never frees, the Heap
+ * (Heap.h) collects those.
+ */
+class Object
+{
+public:
+  Object(ValueType type) : type(type) {}
+
+  ValueType type;
+  uint32_t refs = 0;
+  /* where a closure or cell is in the Heap's list */
+  uint32_t heapIndex = 0;
+};
+
+void freeObject(Object* object);
+/* for closures and cells, might run a collection */
+void trackObject(Object* object);
+
+/*
+ * Strings are ropes: a String is either a flat leaf holding its chars
+ * or a concat node pointing at two other Strings. Concatenation just
+ * makes a node (or copies when the result is tiny) and the tree is
+ * flattened into a single leaf the first time somebody asks for the
+ * chars (print, comparison...). That makes "s = s + x" in a loop linear
+ * instead of copying the whole string every time.
+ */
+class String : public Object
+{
+public:
+  String(std::string chars)
+    : Object(VAL_STRING), length(chars.size()), chars(std::move(chars))
+  {
+    memory.charge(sizeof(String) + length);
+  }
+
+  /* a node's chars belong to its leaves until it's flattened */
+  ~String()
+  {
+    memory.release(sizeof(String) + (isFlat() ? length : 0));
+  }
+
+  static String* concat(String* left, String* right);
+  static void destroy(String* string);
+
+  const std::string& getChars()
+  {
+    if (!isFlat())
+      flatten();
+    return chars;
+  }
+
+  size_t getLength() const
+  {
+    return length;
+  }
+
+  bool isFlat() const
+  {
+    return left == nullptr;
+  }
+private:
+  String(String* left, String* right);
+  void flatten();
+private:
+  size_t length;
+  std::string chars;
+  /* both null for a flat leaf, the node holds a ref on each */
+  String* left = nullptr;
+  String* right = nullptr;
+};
+
+/*
+ * 16 byte tagged value, replaces std::any everywhere at runtime.
+ * numbers and bools are stored inline, strings and callables are
+ * a pointer to a refcounted Object.
+ */
+class Value
+{
+public:
+  Value() : type(VAL_NIL) { as.number = 0; }
+  Value(bool boolean) : type(VAL_BOOL) { as.number = 0; as.boolean = boolean; }
+  Value(double number) : type(VAL_NUMBER) { as.number = number; }
+  Value(String* string) : type(VAL_STRING) { as.object = string; retain(); }
+  Value(Callable* callable);
+  Value(Cell* cell);
+
+  Value(const Value& other) : type(other.type), as(other.as) { retain(); }
+  Value(Value&& other) noexcept : type(other.type), as(other.as) { other.type = VAL_NIL; }
+
+  Value& operator=(const Value& other)
+  {
+    /* retain first so self assignment doesn't free the object */
+    other.retain();
+    release();
+    type = other.type;
+    as = other.as;
+    return *this;
+  }
+
+  Value& operator=(Value&& other) noexcept
+  {
+    if (this != &other)
+    {
+      release();
+      type = other.type;
+      as = other.as;
+      other.type = VAL_NIL;
+    }
+    return *this;
+  }
+
+  ~Value() { release(); }
+
+  static Value undefined()
+  {
+    Value value;
+    value.type = VAL_UNDEFINED;
+    return value;
+  }
+
+  ValueType getType() const { return type; }
+  bool isNil() const { return type == VAL_NIL; }
+  bool isBool() const { return type == VAL_BOOL; }
+  bool isNumber() const { return type == VAL_NUMBER; }
+  bool isString() const { return type == VAL_STRING; }
+  bool isCallable() const { return type == VAL_CALLABLE; }
+  bool isCell() const { return type == VAL_CELL; }
+  bool isUndefined() const { return type == VAL_UNDEFINED; }
+  bool isObject() const { return type >= VAL_STRING; }
+
+  bool asBool() const { return as.boolean; }
+  double asNumber() const { return as.number; }
+  String* asString() const { return static_cast<String*>(as.object); }
+  Callable* asCallable() const;
+  Cell* asCell() const;
+  Object* asObject() const { return as.object; }
+private:
+  void retain() const
+  {
+    if (isObject())
+      as.object->refs++;
+  }
+
+  void release()
+  {
+    if (isObject() && --as.object->refs == 0)
+      freeObject(as.object);
+  }
+private:
+  ValueType type;
+  union
+  {
+    bool boolean;
+    double number;
+    Object* object;
+  } as;
+};
+
+static_assert(sizeof(Value) == 16, "Value should stay 16 bytes");
+
+/*
+ * Box for a local that a closure captured. The frame slot and every
+ * closure that captured it point at the same Cell, so the variable
+ * outlives the call that declared it.
+ */
+class Cell : public Object
+{
+public:
+  Cell(Value value)
+    : Object(VAL_CELL), value(std::move(value))
+  {
+    memory.charge(sizeof(Cell));
+    trackObject(this);
+  }
+
+  ~Cell()
+  {
+    memory.release(sizeof(Cell));
+  }
+
+  Value value;
+};
+
+inline Value::Value(Cell* cell) : type(VAL_CELL)
+{
+  as.object = cell;
+  retain();
+}
+
+inline Cell* Value::asCell() const
+{
+  return static_cast<Cell*>(as.object);
+}
@@ -0,0 +1,32 @@
+# fib(30) makes 2.7M calls. Runs it and fib(20) on ENGINE with --stats and
+# fails unless both allocate as much while interpreting, a call that
+# allocated anything would make the count grow with the calls.
+#
+#   cmake -DLSCRIPT=<LScript> -DSCRIPT=<scripts/bench/fib.ls> -DENGINE=<engine> -P CallAllocations.cmake
+
+include("${CMAKE_CURRENT_LIST_DIR}/Engine.cmake")
+
+file(READ "${SCRIPT}" source)
+string(REPLACE "fib(30)" "fib(20)" smaller "${source}")
+if (smaller STREQUAL source)
+  message(FATAL_ERROR "${SCRIPT} doesn't call fib(30)")
+endif()
+file(WRITE "fib20.${ENGINE}.ls" "${smaller}")
+
+set(script_20 "fib20.${ENGINE}.ls")
+set(script_30 "${SCRIPT}")
+set(expected_20 "6765\n")
+set(expected_30 "832040\n")
+foreach (n 20 30)
+  execute_process(COMMAND "${LSCRIPT}" ${ENGINE_FLAGS} --stats "${script_${n}}"
+                  OUTPUT_VARIABLE out ERROR_VARIABLE err RESULT_VARIABLE result)
+  if (result OR NOT out STREQUAL expected_${n} OR NOT err MATCHES "while interpreting: +([0-9]+)")
+    message(FATAL_ERROR "fib(${n}) on ${ENGINE} failed (${result}):\n${out}${err}")
+  endif()
+  set(allocations_${n} ${CMAKE_MATCH_1})
+endforeach()
+file(REMOVE "fib20.${ENGINE}.ls")
+
+if (NOT allocations_20 EQUAL allocations_30)
+  message(FATAL_ERROR "calls allocate on ${ENGINE}: ${allocations_20} allocations while interpreting fib(20), ${allocations_30} for fib(30)")
+endif()
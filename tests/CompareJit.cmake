@@ -0,0 +1,32 @@
+# Runs SCRIPT in the tree walker with --jit=off, --jit=on and --jit=verify
+# and fails if they don't print the same, stdout and stderr. --jit=verify
+# reports its mismatches on stderr, so those fail it too.
+#
+#   cmake -DLSCRIPT=<LScript> -DSCRIPT=<script.ls> [-DARGS=<flags>] -P CompareJit.cmake
+
+get_filename_component(name "${SCRIPT}" NAME_WE)
+
+foreach (mode off on verify)
+  execute_process(COMMAND "${LSCRIPT}" --engine=tree --jit=${mode} ${ARGS} "${SCRIPT}"
+                  OUTPUT_FILE "${name}.${mode}.out" ERROR_FILE "${name}.${mode}.err"
+                  RESULT_VARIABLE result)
+  set(result_${mode} "${result}")
+endforeach()
+
+foreach (mode on verify)
+  if (NOT result_${mode} STREQUAL result_off)
+    message(FATAL_ERROR "--jit=${mode} exited with ${result_${mode}}, --jit=off with ${result_off}")
+  endif()
+  foreach (stream out err)
+    execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files "${name}.off.${stream}" "${name}.${mode}.${stream}"
+                    RESULT_VARIABLE different)
+    if (different)
+      message(FATAL_ERROR "--jit=${mode} printed something else than --jit=off, see ${name}.off.${stream} and ${name}.${mode}.${stream}")
+    endif()
+  endforeach()
+endforeach()
+
+# some of the scripts print megabytes
+foreach (mode off on verify)
+  file(REMOVE "${name}.${mode}.out" "${name}.${mode}.err")
+endforeach()
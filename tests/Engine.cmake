@@ -0,0 +1,9 @@
+# ENGINE_FLAGS, the flags that run on ENGINE: tree (the tree walker without
+# its JIT), jit (the tree walker with it), vm or closure
+if (ENGINE STREQUAL "tree")
+  set(ENGINE_FLAGS --engine=tree --jit=off)
+elseif (ENGINE STREQUAL "jit")
+  set(ENGINE_FLAGS --engine=tree --jit=on)
+else()
+  set(ENGINE_FLAGS --engine=${ENGINE})
+endif()
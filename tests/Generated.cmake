@@ -0,0 +1,18 @@
+# Runs the ~6MB script scripts/bench/generate.ls prints on ENGINE, 80K
+# globals and 40K number constants in one chunk for the VM.
+#
+#   cmake -DLSCRIPT=<LScript> -DSCRIPT=<scripts/bench/generate.ls> -DENGINE=<engine> -P Generated.cmake
+
+include("${CMAKE_CURRENT_LIST_DIR}/Engine.cmake")
+
+execute_process(COMMAND "${LSCRIPT}" "${SCRIPT}" OUTPUT_FILE "generated.${ENGINE}.ls" RESULT_VARIABLE result)
+if (result)
+  message(FATAL_ERROR "${SCRIPT} failed (${result})")
+endif()
+
+execute_process(COMMAND "${LSCRIPT}" ${ENGINE_FLAGS} "generated.${ENGINE}.ls"
+                OUTPUT_VARIABLE out ERROR_VARIABLE err RESULT_VARIABLE result)
+file(REMOVE "generated.${ENGINE}.ls")
+if (result OR NOT err STREQUAL "" OR NOT out STREQUAL "1599940002.5\n")
+  message(FATAL_ERROR "the generated script on ${ENGINE} failed (${result}):\n${out}${err}")
+endif()
@@ -0,0 +1,13 @@
+# Runs tests/TailCalls.ls on ENGINE, millions of tail calls that end in
+# "Stack overflow." unless every one reuses its frame.
+#
+#   cmake -DLSCRIPT=<LScript> -DENGINE=<engine> -P TailCalls.cmake
+
+include("${CMAKE_CURRENT_LIST_DIR}/Engine.cmake")
+
+execute_process(COMMAND "${LSCRIPT}" ${ENGINE_FLAGS} "${CMAKE_CURRENT_LIST_DIR}/TailCalls.ls"
+                OUTPUT_VARIABLE out ERROR_VARIABLE err RESULT_VARIABLE result)
+set(expected "3000000\nfalse\nspun\n1000000\n")
+if (result OR NOT err STREQUAL "" OR NOT out STREQUAL expected)
+  message(FATAL_ERROR "tail calls on ${ENGINE} failed (${result}):\n${out}${err}")
+endif()